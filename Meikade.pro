@@ -25,11 +25,16 @@ contains(DEFINES,OLD_DATABASE) {
 }
 
 DEFINES += DISABLE_KEYCHAIN
+
+# Memory mapped UTF-16 copy of the verses next to data.sqlite (PoemCorpus),
+# for search and poem reads. Takes about the size of the database on disk.
+# DEFINES += POEM_CORPUS
+
 include(qmake/qtcAddDeployment.pri)
 include(asemantools/asemantools.pri)
 qtcAddDeployment()
 
-QT += sql qml quick xml
+QT += sql qml quick xml network concurrent
 
 SOURCES += main.cpp \
     listobject.cpp \
@@ -53,7 +58,18 @@ SOURCES += main.cpp \
     poetimageprovider.cpp \
     apilayer.cpp \
     networkfeatures.cpp \
-    xmldownloaderproxymodel.cpp
+    xmldownloaderproxymodel.cpp \
+    databaseconnectionpool.cpp \
+    meikadedatabasemigrator.cpp \
+    meikadedatabaseworker.cpp \
+    versecodec.cpp \
+    poemcorpus.cpp \
+    downloadscheduler.cpp \
+    poetthumbnailcache.cpp \
+    poetthumbnailatlas.cpp \
+    stickerrenderer.cpp \
+    userdatachangelog.cpp \
+    userdatawriter.cpp
 
 HEADERS += \
     listobject.h \
@@ -80,7 +96,18 @@ HEADERS += \
     apilayer.h \
     networkfeatures.h \
     xmldownloaderproxymodel.h \
-    poetremover.h
+    poetremover.h \
+    databaseconnectionpool.h \
+    meikadedatabasemigrator.h \
+    meikadedatabaseworker.h \
+    versecodec.h \
+    poemcorpus.h \
+    downloadscheduler.h \
+    poetthumbnailcache.h \
+    poetthumbnailatlas.h \
+    stickerrenderer.h \
+    userdatachangelog.h \
+    userdatawriter.h
 
 OTHER_FILES += \
     android/AndroidManifest.xml \
@@ -45,9 +45,16 @@
 #include <QtEndian>
 #include <QDate>
 #include <QTime>
+#include <QAtomicInt>
 
 #include <QDebug>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 
 #define ROUNDS 32
 #define KEYSIZE_RC5 20
@@ -874,6 +881,27 @@ QByteArray CBC::decrypt(const QByteArray cipher, bool end) {
             quint32 pln2;
             quint32 pln3;
             quint32 pln4;
+            quint32 X[16];
+            // blocks decrypt independently in CBC, four at a time
+            while ( plainlen - plainpos >= 4*worksize ) {
+                for (int i = 0 ; i < 16 ; i++)
+                    X[i] = qFromLittleEndian<quint32>(bufdat + bufferpos + 4*i);
+                serpent_decrypt_4x(X, key->serpent);
+                qToLittleEndian( (X[0] ^ cbc1) , plndat + plainpos);
+                qToLittleEndian( (X[1] ^ cbc2) , plndat + plainpos + 4);
+                qToLittleEndian( (X[2] ^ cbc3) , plndat + plainpos + 8);
+                qToLittleEndian( (X[3] ^ cbc4) , plndat + plainpos + 12);
+                for (int i = 4 ; i < 16 ; i++)
+                    qToLittleEndian( (X[i] ^ qFromLittleEndian<quint32>(bufdat + bufferpos + 4*i - 16)) ,
+                                     plndat + plainpos + 4*i);
+                cbc1 = qFromLittleEndian<quint32>(bufdat + bufferpos + 48);
+                cbc2 = qFromLittleEndian<quint32>(bufdat + bufferpos + 52);
+                cbc3 = qFromLittleEndian<quint32>(bufdat + bufferpos + 56);
+                cbc4 = qFromLittleEndian<quint32>(bufdat + bufferpos + 60);
+
+                plainpos += 4*worksize;
+                bufferpos += 4*worksize;
+            }
             while ( plainpos < plainlen ) {
                 pln1 = buf1 = qFromLittleEndian<quint32>(bufdat+bufferpos);
                 pln2 = buf2 = qFromLittleEndian<quint32>(bufdat+bufferpos + 4);
@@ -1325,8 +1353,31 @@ QByteArray CFB::decrypt(const QByteArray cipher, bool end) {
                 quint32 C2 = 0;
                 quint32 C3 = 0;
                 quint32 C4 = 0;
+                quint32 X[16];
+
+                // the keystream of a block only depends on the previous
+                // cipher block, so four blocks are decrypted at a time
+                while ( cipherlen - cipherpos >= 4*bufferlen ) {
+                    X[0] = B1;
+                    X[1] = B2;
+                    X[2] = B3;
+                    X[3] = B4;
+                    for (int i = 4 ; i < 16 ; i++)
+                        X[i] = qFromLittleEndian<quint32>(cphdat + cipherpos + 4*i - 16);
+                    serpent_encrypt_4x(X, key->serpent);
+                    for (int i = 0 ; i < 16 ; i++)
+                        qToLittleEndian( (X[i] ^ qFromLittleEndian<quint32>(cphdat + cipherpos + 4*i)) ,
+                                         plndat + plainpos + 4*i);
+                    B1 = qFromLittleEndian<quint32>(cphdat + cipherpos + 48);
+                    B2 = qFromLittleEndian<quint32>(cphdat + cipherpos + 52);
+                    B3 = qFromLittleEndian<quint32>(cphdat + cipherpos + 56);
+                    B4 = qFromLittleEndian<quint32>(cphdat + cipherpos + 60);
+                    cipherpos += 4*bufferlen;
+                    plainpos += 4*bufferlen;
+                }
+                copysize = qMin( bufferlen , cipherlen - cipherpos );
 
-                do {
+                while ( bufferlen == copysize ) {
                     serpent_encrypt_4w(B1,B2,B3,B4,key->serpent);
                     C1 = qFromLittleEndian<quint32>(cphdat + cipherpos);
                     C2 = qFromLittleEndian<quint32>(cphdat + cipherpos + 4);
@@ -1347,7 +1398,7 @@ QByteArray CFB::decrypt(const QByteArray cipher, bool end) {
                     cipherpos += copysize;
                     plainpos += copysize;
                     copysize = qMin( bufferlen , cipherlen - cipherpos );
-                } while ( bufferlen == copysize );
+                }
                 qToLittleEndian(B1, bufdat);
                 qToLittleEndian(B2, bufdat + 4);
                 qToLittleEndian(B3, bufdat + 8);
@@ -1764,6 +1815,347 @@ void serpent_decrypt_16b(const uchar *cipher16, uchar *plain16, const quint32 *s
     qToLittleEndian(X4, plain16 + 12);
 }
 
+/* SERPENT 4 BLOCK KERNELS */
+
+/*
+ * The S-boxes above are bit permutations of 16 bit halves looked up from
+ * tables, so the rounds can not be bitsliced without changing the cipher.
+ * Instead four independent blocks go through the rounds side by side: the
+ * table lookups of the blocks overlap and the linear transformation runs
+ * on all four blocks at once (in SSE2/NEON registers when available).
+ * Inside the kernels the state is word major, W[4*word + block].
+ */
+
+#if defined(__SSE2__)
+#define SERPENT_SIMD
+typedef __m128i serpent_v;
+#define V_LOAD(p)    _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p,v) _mm_storeu_si128((__m128i *)(p), (v))
+#define V_SET1(x)    _mm_set1_epi32((int)(x))
+#define V_XOR(a,b)   _mm_xor_si128((a), (b))
+#define V_OR(a,b)    _mm_or_si128((a), (b))
+#define V_SHL(a,n)   _mm_slli_epi32((a), (n))
+#define V_SHR(a,n)   _mm_srli_epi32((a), (n))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SERPENT_SIMD
+typedef uint32x4_t serpent_v;
+#define V_LOAD(p)    vld1q_u32(p)
+#define V_STORE(p,v) vst1q_u32((p), (v))
+#define V_SET1(x)    vdupq_n_u32(x)
+#define V_XOR(a,b)   veorq_u32((a), (b))
+#define V_OR(a,b)    vorrq_u32((a), (b))
+#define V_SHL(a,n)   vshlq_n_u32((a), (n))
+#define V_SHR(a,n)   vshrq_n_u32((a), (n))
+#endif
+
+#ifdef SERPENT_SIMD
+#define V_ROTL(a,n)  V_OR(V_SHL((a), (n)), V_SHR((a), 32-(n)))
+#define V_ROTR(a,n)  V_OR(V_SHR((a), (n)), V_SHL((a), 32-(n)))
+#endif
+
+static QAtomicInt serpent_kernel_selected(SerpentAuto);
+
+static inline void serpent_transpose_4x(quint32 *W, const quint32 *X) {
+    for (int i = 0 ; i < 4 ; i++)
+        for (int j = 0 ; j < 4 ; j++)
+            W[4*i + j] = X[4*j + i];
+}
+
+static inline void serpent_sbox_4x(int sbox, quint32 *W) {
+#ifdef WITH_SERPENT_FAST_SBOX
+    for (int i = 0 ; i < 16 ; i++)
+        W[i] = serpent_sbox_fast(sbox, W[i]);
+#else
+    for (int b = 0 ; b < 4 ; b++)
+        serpent_sbox_it(sbox, W[b], W[4 + b], W[8 + b], W[12 + b]);
+#endif
+}
+
+static void serpent_encrypt_4x_scalar(quint32 *X, const quint32 *s) {
+    for (int b = 0 ; b < 16 ; b += 4)
+        serpent_encrypt_4w(X[b], X[b + 1], X[b + 2], X[b + 3], s);
+}
+
+static void serpent_decrypt_4x_scalar(quint32 *X, const quint32 *s) {
+    for (int b = 0 ; b < 16 ; b += 4)
+        serpent_decrypt_4w(X[b], X[b + 1], X[b + 2], X[b + 3], s);
+}
+
+static void serpent_encrypt_4x_interleaved(quint32 *X, const quint32 *s) {
+    quint32 W[16];
+    quint32 *X1 = W, *X2 = W + 4, *X3 = W + 8, *X4 = W + 12;
+    int round, b;
+
+    serpent_transpose_4x(W, X);
+
+    round = 0;
+    while ( 1 ) {
+        for (b = 0 ; b < 4 ; b++) {
+            X1[b] ^= s[4*round    ];
+            X2[b] ^= s[4*round + 1];
+            X3[b] ^= s[4*round + 2];
+            X4[b] ^= s[4*round + 3];
+        }
+
+        serpent_sbox_4x(round & 0x7, W);
+        if ( round == ROUNDS-1 ) break;
+
+        for (b = 0 ; b < 4 ; b++) {
+            X1[b] = ROTL32(X1[b], 13);
+            X3[b] = ROTL32(X3[b], 3);
+            X2[b] = X2[b] ^ X1[b] ^ X3[b];
+            X4[b] = X4[b] ^ X3[b] ^ ( X1[b] << 3 );
+            X2[b] = ROTL32(X2[b], 1);
+            X4[b] = ROTL32(X4[b], 7);
+            X1[b] = X1[b] ^ X2[b] ^ X4[b];
+            X3[b] = X3[b] ^ X4[b] ^ ( X2[b] << 7 );
+            X1[b] = ROTL32(X1[b], 5);
+            X3[b] = ROTL32(X3[b], 22);
+        }
+
+        round++;
+    }
+
+    for (b = 0 ; b < 4 ; b++) {
+        X1[b] ^= s[128];
+        X2[b] ^= s[129];
+        X3[b] ^= s[130];
+        X4[b] ^= s[131];
+    }
+
+    serpent_transpose_4x(X, W);
+}
+
+static void serpent_decrypt_4x_interleaved(quint32 *X, const quint32 *s) {
+    quint32 W[16];
+    quint32 *X1 = W, *X2 = W + 4, *X3 = W + 8, *X4 = W + 12;
+    int round, b;
+
+    serpent_transpose_4x(W, X);
+
+    for (b = 0 ; b < 4 ; b++) {
+        X1[b] ^= s[128];
+        X2[b] ^= s[129];
+        X3[b] ^= s[130];
+        X4[b] ^= s[131];
+    }
+
+    round = ROUNDS - 1;
+    while ( 1 ) {
+        serpent_sbox_4x((round & 0x7) + 8, W);
+
+        for (b = 0 ; b < 4 ; b++) {
+            X1[b] ^= s[4*round    ];
+            X2[b] ^= s[4*round + 1];
+            X3[b] ^= s[4*round + 2];
+            X4[b] ^= s[4*round + 3];
+        }
+
+        round--;
+        if ( -1 == round ) break;
+
+        for (b = 0 ; b < 4 ; b++) {
+            X3[b] = ROTR32(X3[b], 22);
+            X1[b] = ROTR32(X1[b], 5);
+            X3[b] = X3[b] ^ X4[b] ^ (X2[b] << 7);
+            X1[b] = X1[b] ^ X2[b] ^ X4[b];
+            X4[b] = ROTR32(X4[b], 7);
+            X2[b] = ROTR32(X2[b], 1);
+            X4[b] = X4[b] ^ X3[b] ^ (X1[b] << 3);
+            X2[b] = X2[b] ^ X1[b] ^ X3[b];
+            X3[b] = ROTR32(X3[b], 3);
+            X1[b] = ROTR32(X1[b], 13);
+        }
+    }
+
+    serpent_transpose_4x(X, W);
+}
+
+#ifdef SERPENT_SIMD
+static void serpent_encrypt_4x_simd(quint32 *X, const quint32 *s) {
+    quint32 W[16];
+    serpent_v X1, X2, X3, X4;
+    int round;
+
+    serpent_transpose_4x(W, X);
+    X1 = V_LOAD(W);
+    X2 = V_LOAD(W + 4);
+    X3 = V_LOAD(W + 8);
+    X4 = V_LOAD(W + 12);
+
+    round = 0;
+    while ( 1 ) {
+        X1 = V_XOR(X1, V_SET1(s[4*round    ]));
+        X2 = V_XOR(X2, V_SET1(s[4*round + 1]));
+        X3 = V_XOR(X3, V_SET1(s[4*round + 2]));
+        X4 = V_XOR(X4, V_SET1(s[4*round + 3]));
+
+        V_STORE(W, X1);
+        V_STORE(W + 4, X2);
+        V_STORE(W + 8, X3);
+        V_STORE(W + 12, X4);
+        serpent_sbox_4x(round & 0x7, W);
+        X1 = V_LOAD(W);
+        X2 = V_LOAD(W + 4);
+        X3 = V_LOAD(W + 8);
+        X4 = V_LOAD(W + 12);
+        if ( round == ROUNDS-1 ) break;
+
+        X1 = V_ROTL(X1, 13);
+        X3 = V_ROTL(X3, 3);
+        X2 = V_XOR(V_XOR(X2, X1), X3);
+        X4 = V_XOR(V_XOR(X4, X3), V_SHL(X1, 3));
+        X2 = V_ROTL(X2, 1);
+        X4 = V_ROTL(X4, 7);
+        X1 = V_XOR(V_XOR(X1, X2), X4);
+        X3 = V_XOR(V_XOR(X3, X4), V_SHL(X2, 7));
+        X1 = V_ROTL(X1, 5);
+        X3 = V_ROTL(X3, 22);
+
+        round++;
+    }
+
+    V_STORE(W, V_XOR(X1, V_SET1(s[128])));
+    V_STORE(W + 4, V_XOR(X2, V_SET1(s[129])));
+    V_STORE(W + 8, V_XOR(X3, V_SET1(s[130])));
+    V_STORE(W + 12, V_XOR(X4, V_SET1(s[131])));
+    serpent_transpose_4x(X, W);
+}
+
+static void serpent_decrypt_4x_simd(quint32 *X, const quint32 *s) {
+    quint32 W[16];
+    serpent_v X1, X2, X3, X4;
+    int round;
+
+    serpent_transpose_4x(W, X);
+    V_STORE(W, V_XOR(V_LOAD(W), V_SET1(s[128])));
+    V_STORE(W + 4, V_XOR(V_LOAD(W + 4), V_SET1(s[129])));
+    V_STORE(W + 8, V_XOR(V_LOAD(W + 8), V_SET1(s[130])));
+    V_STORE(W + 12, V_XOR(V_LOAD(W + 12), V_SET1(s[131])));
+
+    round = ROUNDS - 1;
+    while ( 1 ) {
+        serpent_sbox_4x((round & 0x7) + 8, W);
+        X1 = V_XOR(V_LOAD(W), V_SET1(s[4*round    ]));
+        X2 = V_XOR(V_LOAD(W + 4), V_SET1(s[4*round + 1]));
+        X3 = V_XOR(V_LOAD(W + 8), V_SET1(s[4*round + 2]));
+        X4 = V_XOR(V_LOAD(W + 12), V_SET1(s[4*round + 3]));
+
+        round--;
+        if ( -1 != round ) {
+            X3 = V_ROTR(X3, 22);
+            X1 = V_ROTR(X1, 5);
+            X3 = V_XOR(V_XOR(X3, X4), V_SHL(X2, 7));
+            X1 = V_XOR(V_XOR(X1, X2), X4);
+            X4 = V_ROTR(X4, 7);
+            X2 = V_ROTR(X2, 1);
+            X4 = V_XOR(V_XOR(X4, X3), V_SHL(X1, 3));
+            X2 = V_XOR(V_XOR(X2, X1), X3);
+            X3 = V_ROTR(X3, 3);
+            X1 = V_ROTR(X1, 13);
+        }
+
+        V_STORE(W, X1);
+        V_STORE(W + 4, X2);
+        V_STORE(W + 8, X3);
+        V_STORE(W + 12, X4);
+        if ( -1 == round ) break;
+    }
+
+    serpent_transpose_4x(X, W);
+}
+#endif // SERPENT_SIMD
+
+static SerpentKernel serpent_kernel_default() {
+    const QByteArray name = qgetenv("SIMPLEQTCRYPTOR_SERPENT_KERNEL");
+    for (int k = SerpentScalar ; k <= SerpentSimd ; k++) {
+        if ( name == serpent_kernel_name((SerpentKernel)k) &&
+             serpent_kernel_available((SerpentKernel)k) )
+            return (SerpentKernel)k;
+    }
+#ifdef SERPENT_SIMD
+    return SerpentSimd;
+#else
+    return SerpentInterleaved;
+#endif
+}
+
+bool serpent_kernel_available(SerpentKernel k) {
+    switch (k) {
+    case SerpentScalar:
+    case SerpentInterleaved:
+        return true;
+#ifdef SERPENT_SIMD
+    case SerpentSimd:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+SerpentKernel serpent_kernel() {
+    int k = serpent_kernel_selected.loadAcquire();
+    if ( SerpentAuto == k ) {
+        k = serpent_kernel_default();
+        serpent_kernel_selected.testAndSetOrdered(SerpentAuto, k);
+    }
+    return (SerpentKernel)k;
+}
+
+bool serpent_set_kernel(SerpentKernel k) {
+    if ( SerpentAuto != k && !serpent_kernel_available(k) )
+        return false;
+
+    serpent_kernel_selected.storeRelease( SerpentAuto == k ? serpent_kernel_default() : k );
+    return true;
+}
+
+const char *serpent_kernel_name(SerpentKernel k) {
+    switch (k) {
+    case SerpentScalar:
+        return "scalar";
+    case SerpentInterleaved:
+        return "interleaved";
+    case SerpentSimd:
+        return "simd";
+    default:
+        return "auto";
+    }
+}
+
+void serpent_encrypt_4x(quint32 *X, const quint32 *s) {
+    switch (serpent_kernel()) {
+    case SerpentScalar:
+        serpent_encrypt_4x_scalar(X, s);
+        return;
+#ifdef SERPENT_SIMD
+    case SerpentSimd:
+        serpent_encrypt_4x_simd(X, s);
+        return;
+#endif
+    default:
+        serpent_encrypt_4x_interleaved(X, s);
+        return;
+    }
+}
+
+void serpent_decrypt_4x(quint32 *X, const quint32 *s) {
+    switch (serpent_kernel()) {
+    case SerpentScalar:
+        serpent_decrypt_4x_scalar(X, s);
+        return;
+#ifdef SERPENT_SIMD
+    case SerpentSimd:
+        serpent_decrypt_4x_simd(X, s);
+        return;
+#endif
+    default:
+        serpent_decrypt_4x_interleaved(X, s);
+        return;
+    }
+}
+
 
 #ifdef WITH_SERPENT_PRINT_SBOX_H
 void serpent_print_sbox_h() {
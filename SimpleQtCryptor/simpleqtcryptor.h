@@ -293,6 +293,25 @@ void serpent_decrypt_4w(quint32 &X1, quint32 &X2,
 void serpent_encrypt_16b(const uchar *plain16, uchar *cipher16, const quint32 *s);
 void serpent_decrypt_16b(const uchar *cipher16, uchar *plain16, const quint32 *s);
 
+// four independent blocks at once, block after block (X[4*block + word]),
+// input replaced by output. SerpentAuto picks the fastest kernel built in;
+// the SIMPLEQTCRYPTOR_SERPENT_KERNEL environment variable (scalar,
+// interleaved or simd) overrides it.
+enum SerpentKernel {
+    SerpentAuto = 0,
+    SerpentScalar,
+    SerpentInterleaved,
+    SerpentSimd
+};
+
+bool serpent_kernel_available(SerpentKernel k);
+SerpentKernel serpent_kernel();
+bool serpent_set_kernel(SerpentKernel k);
+const char *serpent_kernel_name(SerpentKernel k);
+
+void serpent_encrypt_4x(quint32 *X, const quint32 *s);
+void serpent_decrypt_4x(quint32 *X, const quint32 *s);
+
 #ifdef WITH_SERPENT_PRINT_SBOX_H
 void serpent_print_sbox_h();
 #endif
@@ -16,21 +16,42 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define BACKUP_CHAIN_LIMIT 16
+#define BACKUP_DELTA_MAGIC "MKDELTA 1"
+#define BACKUP_DELTA_NAME "userdata.delta"
+#define BACKUP_CHAIN_NAME "chain.info"
+#define BACKUP_USERDATA_NAME "userdata.sqlite"
+#define BACKUP_DB_CONNECTION "backuper_sqlite"
+
 #include "backuper.h"
 #include "resourcemanager.h"
+#include "userdatachangelog.h"
 #include "meikade_macros.h"
 
 #include <QThread>
 #include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QSettings>
+#include <QUuid>
+#include <QDataStream>
+#include <QSqlDatabase>
 #include <QDebug>
 
+#include <functional>
+
+static QString backupChainPath()
+{
+    return HOME_PATH + "/backups.ini";
+}
+
 class BackuperPrivate
 {
 public:
     QThread *thread;
     BackuperCore *core;
     bool active;
+    qreal progress;
 };
 
 Backuper::Backuper() :
@@ -38,6 +59,7 @@ Backuper::Backuper() :
 {
     p = new BackuperPrivate;
     p->active = false;
+    p->progress = 0;
 
     p->thread = new QThread();
 
@@ -46,6 +68,7 @@ Backuper::Backuper() :
 
     connect( p->core, SIGNAL(success()), SLOT(process_successed()), Qt::QueuedConnection );
     connect( p->core, SIGNAL(failed()) , SLOT(process_failed())   , Qt::QueuedConnection );
+    connect( p->core, SIGNAL(progress(qreal)), SLOT(process_progress(qreal)), Qt::QueuedConnection );
 
     p->thread->start();
 }
@@ -55,6 +78,11 @@ bool Backuper::isActive() const
     return p->active;
 }
 
+qreal Backuper::progress() const
+{
+    return p->progress;
+}
+
 void Backuper::makeBackup()
 {
     if( isActive() )
@@ -78,6 +106,47 @@ bool Backuper::restore( const QString & path )
     return true;
 }
 
+/*!
+ * The incremental backups that can't be restored without path: the ones
+ * made on top of it in the same chain.
+ */
+QStringList Backuper::dependents(const QString &path) const
+{
+    const QFileInfo info(path);
+    QStringList result;
+
+    QSettings chain(backupChainPath(), QSettings::IniFormat);
+    chain.beginGroup("parents");
+    for( const QString &file: chain.childKeys() )
+        if( chain.value(file).toStringList().contains(info.fileName()) && info.dir().exists(file) )
+            result << info.dir().filePath(file);
+    chain.endGroup();
+
+    return result;
+}
+
+/*!
+ * Removes the backup with every backup that depends on it, so no
+ * incremental backup is left without its chain.
+ */
+bool Backuper::remove(const QString &path)
+{
+    if( isActive() )
+        return false;
+
+    const QStringList files = dependents(path) << path;
+
+    QSettings chain(backupChainPath(), QSettings::IniFormat);
+    bool result = true;
+    for( const QString &file: files )
+    {
+        result = QFile::remove(file) && result;
+        chain.remove("parents/" + QFileInfo(file).fileName());
+    }
+
+    return result;
+}
+
 void Backuper::process_successed()
 {
     p->active = false;
@@ -85,6 +154,15 @@ void Backuper::process_successed()
     emit activeChanged();
 }
 
+void Backuper::process_progress(qreal progress)
+{
+    if( p->progress == progress )
+        return;
+
+    p->progress = progress;
+    emit progressChanged();
+}
+
 void Backuper::process_failed()
 {
     p->active = false;
@@ -101,11 +179,77 @@ Backuper::~Backuper()
 
 
 
+/*!
+ * Full backups hold userdata.sqlite and a chain.info naming the chain they
+ * start. Incremental backups hold a userdata.delta: the chain id, the file
+ * names of the full backup and of the incremental backups before it, the
+ * changelog sequence it reaches, then the changed rows (see
+ * UserDataChangeLog). The chain state of the next backup is kept in
+ * backups.ini beside the database, with the parents of every incremental
+ * backup so the dialog can tell which backups a removal would break.
+ */
 class BackuperCorePrivate
 {
 public:
+    QString userdataPath() const { return HOME_PATH + "/" BACKUP_USERDATA_NAME; }
+    QString chainPath() const { return backupChainPath(); }
 };
 
+static bool backupWithDatabase(const QString &path, const std::function<bool(QSqlDatabase &db)> &callback)
+{
+    bool result = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", BACKUP_DB_CONNECTION);
+        db.setDatabaseName(path);
+        if( db.open() )
+        {
+            result = callback(db);
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(BACKUP_DB_CONNECTION);
+    return result;
+}
+
+static bool backupReadDeltaHead(QDataStream &stream, QString *chainId, QStringList *parents)
+{
+    QByteArray magic;
+    qint64 sequence;
+    stream >> magic >> *chainId >> *parents >> sequence;
+    return stream.status() == QDataStream::Ok && magic == BACKUP_DELTA_MAGIC && !parents->isEmpty();
+}
+
+/*!
+ * Extracts the delta of an incremental backup of the chain and applies it
+ * on the database.
+ */
+static bool backupApplyDelta(QSqlDatabase &db, const QString &path, const QString &chainId)
+{
+    const QString tmp = HOME_PATH + "/tmp_delta";
+
+    ResourceManager rsrc( path, false );
+    if( !rsrc.checkHead() || rsrc.extractFile(tmp) != BACKUP_DELTA_NAME )
+    {
+        QFile::remove(tmp);
+        return false;
+    }
+
+    QFile file(tmp);
+    bool result = file.open(QFile::ReadOnly);
+    if( result )
+    {
+        QDataStream stream(&file);
+        QString id;
+        QStringList parents;
+        result = backupReadDeltaHead(stream, &id, &parents) && id == chainId &&
+                 UserDataChangeLog::applyDelta(db, stream);
+        file.close();
+    }
+
+    QFile::remove(tmp);
+    return result;
+}
+
 BackuperCore::BackuperCore()
 {
     p = new BackuperCorePrivate;
@@ -116,17 +260,139 @@ void BackuperCore::makeBackup()
     QString path = BACKUP_PATH;
     QDir().mkpath(path);
 
-    QString dest = path + "/meikade_backup_" + QDateTime::currentDateTime().toString("ddd - MMM dd yyyy - hh_mm") + ".mkdb";
+    const QString date = QDateTime::currentDateTime().toString("ddd - MMM dd yyyy - hh_mm");
+
+    emit progress(0);
+
+    QSettings chain(p->chainPath(), QSettings::IniFormat);
+    QString chainId = chain.value("chain/id").toString();
+    QString base = chain.value("chain/base").toString();
+    QStringList deltas = chain.value("chain/deltas").toStringList();
+    const qint64 since = chain.value("chain/sequence", -1).toLongLong();
+
+    const QStringList chainFiles = QStringList(deltas) << base;
+    bool incremental = !chainId.isEmpty() && deltas.count() < BACKUP_CHAIN_LIMIT;
+    for( const QString &file: chainFiles )
+        incremental = incremental && QFileInfo::exists(path + "/" + file);
+
+    const QString deltaFile = HOME_PATH + "/" BACKUP_DELTA_NAME;
+    qint64 sequence = 0;
+    const bool written = backupWithDatabase( p->userdataPath(), [&](QSqlDatabase &db){
+        UserDataChangeLog::init(db);
+        sequence = UserDataChangeLog::sequence(db);
+        if( !incremental || !UserDataChangeLog::covers(db, since) )
+            return false;
+
+        QFile file(deltaFile);
+        if( !file.open(QFile::WriteOnly) )
+            return false;
+
+        QDataStream stream(&file);
+        stream << QByteArray(BACKUP_DELTA_MAGIC) << chainId << (QStringList(base) << deltas) << sequence;
+        return UserDataChangeLog::writeDelta(db, since, stream);
+    });
+    incremental = incremental && written;
+
+    QString dest = path + "/meikade_backup_" + date;
+    if( incremental )
+        dest += " - " + QString::number(deltas.count()+1);
+    dest += ".mkdb";
 
     ResourceManager rsrc( dest, true );
+    rsrc.setProgressCallback([this](qint64 done, qint64 total){
+        emit progress(total? qreal(done)/total : 1);
+    });
     rsrc.writeHead();
-    rsrc.addFile( HOME_PATH + "/userdata.sqlite" );
+    if( incremental )
+    {
+        rsrc.addFile( deltaFile );
+        chain.setValue("parents/" + QFileInfo(dest).fileName(), QStringList(base) << deltas);
+        deltas << QFileInfo(dest).fileName();
+    }
+    else
+    {
+        chainId = QUuid::createUuid().toString();
+        base = QFileInfo(dest).fileName();
+        deltas.clear();
+
+        QFile info(HOME_PATH + "/" BACKUP_CHAIN_NAME);
+        if( info.open(QFile::WriteOnly) )
+        {
+            info.write(chainId.toUtf8());
+            info.close();
+        }
+
+        rsrc.addFile( p->userdataPath() );
+        rsrc.addFile( info.fileName() );
+        info.remove();
+    }
     rsrc.close();
+    QFile::remove(deltaFile);
+
+    chain.setValue("chain/id", chainId);
+    chain.setValue("chain/base", base);
+    chain.setValue("chain/deltas", deltas);
+    chain.setValue("chain/sequence", sequence);
+    chain.sync();
 
-    QThread::sleep(3);
+    backupWithDatabase( p->userdataPath(), [sequence](QSqlDatabase &db){
+        UserDataChangeLog::prune(db, sequence);
+        return true;
+    });
+
+    emit progress(1);
     emit success();
 }
 
+/*!
+ * An incremental backup is replayed on the full backup of its chain, then
+ * every delta of the chain up to it is applied in order.
+ */
+bool BackuperCore::restoreChain(const QString &path, const QString &deltaPath, const QString &dest)
+{
+    QString chainId;
+    QStringList parents;
+
+    QFile delta(deltaPath);
+    if( !delta.open(QFile::ReadOnly) )
+        return false;
+
+    QDataStream stream(&delta);
+    if( !backupReadDeltaHead(stream, &chainId, &parents) )
+        return false;
+
+    const QDir dir = QFileInfo(path).dir();
+    const QString info = HOME_PATH + "/tmp_chain";
+
+    ResourceManager base( dir.filePath(parents.takeFirst()), false );
+    if( !base.checkHead() )
+        return false;
+
+    base.setProgressCallback([this](qint64 done, qint64 total){
+        emit progress(total? qreal(done)/total : 1);
+    });
+    if( base.extractFile(dest) != BACKUP_USERDATA_NAME )
+        return false;
+
+    bool result = (base.extractFile(info) == BACKUP_CHAIN_NAME);
+    if( result )
+    {
+        QFile file(info);
+        result = file.open(QFile::ReadOnly) && QString::fromUtf8(file.readAll()) == chainId;
+    }
+    QFile::remove(info);
+    if( !result )
+        return false;
+
+    return backupWithDatabase( dest, [&](QSqlDatabase &db){
+        for( const QString &parent: parents )
+            if( !backupApplyDelta(db, dir.filePath(parent), chainId) )
+                return false;
+
+        return UserDataChangeLog::applyDelta(db, stream);
+    });
+}
+
 void BackuperCore::restore(const QString &path)
 {
     ResourceManager rsrc( path, false );
@@ -136,13 +402,43 @@ void BackuperCore::restore(const QString &path)
         return;
     }
 
-    QFile::remove( HOME_PATH + "/userdata.sqlite" );
+    emit progress(0);
+    rsrc.setProgressCallback([this](qint64 done, qint64 total){
+        emit progress(total? qreal(done)/total : 1);
+    });
+
     QString tmp_file = HOME_PATH + "/tmp_file";
     QString fileName = rsrc.extractFile( tmp_file );
+    if( fileName == BACKUP_DELTA_NAME )
+    {
+        const QString tmp_delta = HOME_PATH + "/tmp_file.delta";
+        QFile::remove(tmp_delta);
+        QFile(tmp_file).rename(tmp_delta);
+
+        fileName = restoreChain(path, tmp_delta, tmp_file)? QString(BACKUP_USERDATA_NAME) : QString();
+        QFile::remove(tmp_delta);
+    }
 
+    if( fileName.isEmpty() )
+    {
+        QFile::remove(tmp_file);
+        emit failed();
+        return;
+    }
+
+    // the chain of the restored database is unknown, drop its changelog
+    // until the next backup starts a new chain
+    if( fileName == BACKUP_USERDATA_NAME )
+        backupWithDatabase( tmp_file, [](QSqlDatabase &db){
+            return UserDataChangeLog::drop(db);
+        });
+
+    QFile::remove( HOME_PATH + "/" + fileName );
     QFile(tmp_file).rename(HOME_PATH + "/" + fileName);
 
-    QThread::sleep(3);
+    QSettings(p->chainPath(), QSettings::IniFormat).remove("chain");
+
+    emit progress(1);
     emit success();
 }
 
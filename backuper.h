@@ -20,29 +20,37 @@
 #define BACKUPER_H
 
 #include <QObject>
+#include <QStringList>
 
 class BackuperPrivate;
 class Backuper : public QObject
 {
     Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
     Q_OBJECT
 public:
     Backuper();
     ~Backuper();
 
     bool isActive() const;
+    qreal progress() const;
+
+    Q_INVOKABLE QStringList dependents(const QString &path) const;
 
 public slots:
     void makeBackup();
     bool restore(const QString &path);
+    bool remove(const QString &path);
 
 signals:
     void success();
     void failed();
     void activeChanged();
+    void progressChanged();
 
 private slots:
     void process_successed();
+    void process_progress(qreal progress);
     void process_failed();
 
 private:
@@ -64,6 +72,10 @@ public slots:
 signals:
     void success();
     void failed();
+    void progress(qreal progress);
+
+private:
+    bool restoreChain(const QString &path, const QString &deltaPath, const QString &dest);
 
 private:
     BackuperCorePrivate *p;
@@ -0,0 +1,171 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define POOL_CACHE_SIZE_KB 4096
+#define POOL_MMAP_SIZE 67108864
+#define POOL_BUSY_TIMEOUT 5000
+
+#include "databaseconnectionpool.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QStringList>
+#include <QUuid>
+#include <QSqlError>
+#include <QDebug>
+
+class DatabaseConnectionPoolUnit
+{
+public:
+    DatabaseConnectionPoolUnit(): generation(0) {}
+
+    QString connectionName;
+    QSqlDatabase db;
+    QHash<QString, QSqlQuery> queries;
+    int generation;
+};
+
+class DatabaseConnectionPoolThread
+{
+public:
+    QHash<QString, DatabaseConnectionPoolUnit*> units;
+};
+
+static QMutex database_connection_pool_mutex;
+static QHash<QThread*, DatabaseConnectionPoolThread*> database_connection_pool_threads;
+static QHash<QString, int> database_connection_pool_generations;
+
+static void databaseConnectionPoolCloseUnit(DatabaseConnectionPoolUnit *unit)
+{
+    const QString connectionName = unit->connectionName;
+    unit->queries.clear();
+    unit->db.close();
+    delete unit;
+
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+static void databaseConnectionPoolCloseThread(QThread *thread)
+{
+    database_connection_pool_mutex.lock();
+    DatabaseConnectionPoolThread *data = database_connection_pool_threads.take(thread);
+    database_connection_pool_mutex.unlock();
+    if(!data)
+        return;
+
+    for(DatabaseConnectionPoolUnit *unit: data->units)
+        databaseConnectionPoolCloseUnit(unit);
+
+    delete data;
+}
+
+static DatabaseConnectionPoolUnit *databaseConnectionPoolUnit(const QString &path, DatabaseConnectionPool::OpenMode mode)
+{
+    QThread *thread = QThread::currentThread();
+    const QString key = QString::number(static_cast<int>(mode)) + ":" + path;
+
+    database_connection_pool_mutex.lock();
+    DatabaseConnectionPoolThread *data = database_connection_pool_threads.value(thread);
+    if(!data)
+    {
+        data = new DatabaseConnectionPoolThread;
+        database_connection_pool_threads[thread] = data;
+        QObject::connect(thread, &QObject::destroyed, [thread](){
+            databaseConnectionPoolCloseThread(thread);
+        });
+    }
+    const int generation = database_connection_pool_generations.value(path);
+    database_connection_pool_mutex.unlock();
+
+    DatabaseConnectionPoolUnit *unit = data->units.value(key);
+    if(unit && (unit->generation != generation || !unit->db.isOpen()))
+    {
+        data->units.remove(key);
+        databaseConnectionPoolCloseUnit(unit);
+        unit = 0;
+    }
+    if(unit)
+        return unit;
+
+    unit = new DatabaseConnectionPoolUnit;
+    unit->generation = generation;
+    unit->connectionName = "pool_" + QUuid::createUuid().toString();
+
+    QString options = QString("QSQLITE_BUSY_TIMEOUT=%1").arg(POOL_BUSY_TIMEOUT);
+    if(mode == DatabaseConnectionPool::ReadOnly)
+        options += ";QSQLITE_OPEN_READONLY";
+
+    unit->db = QSqlDatabase::addDatabase("QSQLITE", unit->connectionName);
+    unit->db.setDatabaseName(path);
+    unit->db.setConnectOptions(options);
+    if(!unit->db.open())
+        qDebug() << __PRETTY_FUNCTION__ << unit->db.lastError().text();
+    else
+    {
+        QStringList pragmas = QStringList()
+                << QString("PRAGMA cache_size = -%1").arg(POOL_CACHE_SIZE_KB)
+                << QString("PRAGMA mmap_size = %1").arg(POOL_MMAP_SIZE)
+                << "PRAGMA temp_store = MEMORY";
+
+        foreach(const QString &pragma, pragmas)
+        {
+            QSqlQuery query(unit->db);
+            query.exec(pragma);
+        }
+    }
+
+    data->units[key] = unit;
+    return unit;
+}
+
+QSqlDatabase DatabaseConnectionPool::database(const QString &path, OpenMode mode)
+{
+    return databaseConnectionPoolUnit(path, mode)->db;
+}
+
+QSqlQuery DatabaseConnectionPool::query(const QString &path, const QString &sql, OpenMode mode)
+{
+    DatabaseConnectionPoolUnit *unit = databaseConnectionPoolUnit(path, mode);
+
+    // An active cached statement is still being read by another caller of
+    // this thread (e.g. a lookup nested in a loop), sharing it would replace
+    // that caller's bindings and result set, so hand out a fresh one.
+    const bool cached = unit->queries.contains(sql);
+    if(cached && !unit->queries[sql].isActive())
+        return unit->queries[sql];
+
+    QSqlQuery query(unit->db);
+    if(!query.prepare(sql))
+    {
+        qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+        return query;
+    }
+
+    if(!cached)
+        unit->queries[sql] = query;
+
+    return query;
+}
+
+void DatabaseConnectionPool::invalidate(const QString &path)
+{
+    QMutexLocker locker(&database_connection_pool_mutex);
+    database_connection_pool_generations[path]++;
+}
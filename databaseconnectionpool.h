@@ -0,0 +1,49 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATABASECONNECTIONPOOL_H
+#define DATABASECONNECTIONPOOL_H
+
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+/*!
+ * Hands out one opened and configured sqlite connection per (thread, path,
+ * mode). QSqlDatabase handles may only be used from the thread that created
+ * them, so every thread gets its own connection which lives until the
+ * QThread object is destroyed. Prepared statements are cached per
+ * connection and only handed out while no other caller is reading them;
+ * call finish() on a query returned by query() when done.
+ */
+class DatabaseConnectionPool
+{
+public:
+    enum OpenMode {
+        ReadOnly,
+        ReadWrite
+    };
+
+    static QSqlDatabase database(const QString &path, OpenMode mode = ReadOnly);
+    static QSqlQuery query(const QString &path, const QString &sql, OpenMode mode = ReadOnly);
+
+    /*! Drops every pooled connection of the path. Threads reopen on next use. */
+    static void invalidate(const QString &path);
+};
+
+#endif // DATABASECONNECTIONPOOL_H
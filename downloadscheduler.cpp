@@ -0,0 +1,413 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define DOWNLOAD_RETRY_BASE_DELAY 1000
+#define DOWNLOAD_RETRY_MAX_DELAY 60000
+#define DOWNLOAD_PART_SUFFIX ".part"
+#define DOWNLOAD_VALIDATOR_SUFFIX ".part.validator"
+
+#include "downloadscheduler.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QHash>
+#include <QTimer>
+#include <QPointer>
+#include <QDebug>
+
+class DownloadSchedulerUnit
+{
+public:
+    DownloadSchedulerUnit(): file(0), offset(0), retries(0), waiting(false), checked(false) {}
+
+    QUrl url;
+    QString destination;
+    QPointer<QNetworkReply> reply;
+    QFile *file;
+    qint64 offset;
+    int retries;
+    bool waiting;
+    bool checked;
+};
+
+class DownloadSchedulerPrivate
+{
+public:
+    QNetworkAccessManager *network;
+    QHash<QString, DownloadSchedulerUnit> units;
+    QStringList queue;
+    int maximumParallel;
+    int maximumRetries;
+    int running;
+};
+
+static QByteArray downloadReadValidator(const QString &destination)
+{
+    QFile file(destination + DOWNLOAD_VALIDATOR_SUFFIX);
+    if(!file.open(QFile::ReadOnly))
+        return QByteArray();
+
+    return file.readAll().trimmed();
+}
+
+static void downloadWriteValidator(const QString &destination, const QByteArray &validator)
+{
+    if(validator.isEmpty())
+    {
+        QFile::remove(destination + DOWNLOAD_VALIDATOR_SUFFIX);
+        return;
+    }
+
+    QFile file(destination + DOWNLOAD_VALIDATOR_SUFFIX);
+    if(file.open(QFile::WriteOnly | QFile::Truncate))
+        file.write(validator);
+}
+
+static void downloadRemovePart(const QString &destination)
+{
+    QFile::remove(destination + DOWNLOAD_PART_SUFFIX);
+    QFile::remove(destination + DOWNLOAD_VALIDATOR_SUFFIX);
+}
+
+DownloadScheduler::DownloadScheduler(QObject *parent) :
+    QObject(parent)
+{
+    p = new DownloadSchedulerPrivate;
+    p->network = new QNetworkAccessManager(this);
+    p->maximumParallel = 3;
+    p->maximumRetries = 5;
+    p->running = 0;
+}
+
+void DownloadScheduler::setMaximumParallel(int count)
+{
+    if(count < 1)
+        count = 1;
+    if(p->maximumParallel == count)
+        return;
+
+    p->maximumParallel = count;
+    emit maximumParallelChanged();
+    next();
+}
+
+int DownloadScheduler::maximumParallel() const
+{
+    return p->maximumParallel;
+}
+
+void DownloadScheduler::setMaximumRetries(int count)
+{
+    if(p->maximumRetries == count)
+        return;
+
+    p->maximumRetries = count;
+    emit maximumRetriesChanged();
+}
+
+int DownloadScheduler::maximumRetries() const
+{
+    return p->maximumRetries;
+}
+
+bool DownloadScheduler::contains(const QString &id) const
+{
+    return p->units.contains(id);
+}
+
+bool DownloadScheduler::isActive() const
+{
+    return !p->units.isEmpty();
+}
+
+void DownloadScheduler::enqueue(const QString &id, const QUrl &url, const QString &destination)
+{
+    if(p->units.contains(id))
+        return;
+
+    DownloadSchedulerUnit unit;
+    unit.url = url;
+    unit.destination = destination;
+
+    p->units[id] = unit;
+    p->queue << id;
+    next();
+}
+
+void DownloadScheduler::cancel(const QString &id)
+{
+    if(!p->units.contains(id))
+        return;
+
+    const QString destination = p->units.value(id).destination;
+    stop(id);
+    downloadRemovePart(destination);
+    next();
+}
+
+void DownloadScheduler::stop(const QString &id)
+{
+    DownloadSchedulerUnit unit = p->units.take(id);
+    p->queue.removeAll(id);
+
+    if(unit.reply)
+    {
+        p->running--;
+        unit.reply->disconnect(this);
+        unit.reply->abort();
+        unit.reply->deleteLater();
+    }
+    if(unit.file)
+    {
+        unit.file->close();
+        delete unit.file;
+    }
+}
+
+void DownloadScheduler::next()
+{
+    while(p->running < p->maximumParallel && !p->queue.isEmpty())
+        start(p->queue.takeFirst());
+}
+
+void DownloadScheduler::start(const QString &id)
+{
+    if(!p->units.contains(id))
+        return;
+
+    DownloadSchedulerUnit &unit = p->units[id];
+    unit.waiting = false;
+    unit.checked = false;
+
+    QDir().mkpath(QFileInfo(unit.destination).dir().path());
+
+    unit.file = new QFile(unit.destination + DOWNLOAD_PART_SUFFIX);
+    if(!unit.file->open(QFile::ReadWrite))
+    {
+        const QString error = unit.file->errorString();
+        delete unit.file;
+        p->units.remove(id);
+        emit failed(id, error);
+        return;
+    }
+
+    // Without a validator there's no telling the part belongs to the same
+    // version of the file, so it is only resumed with If-Range.
+    const QByteArray validator = downloadReadValidator(unit.destination);
+    if(validator.isEmpty())
+        unit.file->resize(0);
+
+    unit.offset = unit.file->size();
+    unit.file->seek(unit.offset);
+
+    QNetworkRequest request(unit.url);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 6, 0))
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+#endif
+    if(unit.offset)
+    {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(unit.offset) + "-");
+        request.setRawHeader("If-Range", validator);
+    }
+
+    unit.reply = p->network->get(request);
+    unit.reply->setProperty("downloadId", id);
+    p->running++;
+
+    connect(unit.reply, &QNetworkReply::readyRead, this, &DownloadScheduler::readyRead);
+    connect(unit.reply, &QNetworkReply::finished, this, &DownloadScheduler::replyFinished);
+    connect(unit.reply, &QNetworkReply::downloadProgress, this, &DownloadScheduler::downloadProgress);
+}
+
+QString DownloadScheduler::idOf(QNetworkReply *reply) const
+{
+    if(!reply)
+        return QString();
+
+    const QString id = reply->property("downloadId").toString();
+    if(!p->units.contains(id) || p->units.value(id).reply != reply)
+        return QString();
+
+    return id;
+}
+
+void DownloadScheduler::readyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    const QString id = idOf(reply);
+    if(id.isEmpty())
+        return;
+
+    DownloadSchedulerUnit &unit = p->units[id];
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(status != 200 && status != 206)
+        return;
+
+    if(!unit.checked)
+    {
+        unit.checked = true;
+        if(unit.offset && status == 200)
+        {
+            // The server ignored the Range header or the file changed since
+            // the part was written (If-Range), start the file over.
+            unit.offset = 0;
+            unit.file->resize(0);
+            unit.file->seek(0);
+        }
+        else
+        if(status == 206 && !reply->rawHeader("Content-Range").startsWith("bytes " + QByteArray::number(unit.offset) + "-"))
+        {
+            // Not the range that was asked for, drop the part and retry.
+            unit.offset = 0;
+            unit.file->resize(0);
+            downloadWriteValidator(unit.destination, QByteArray());
+            reply->abort();
+            return;
+        }
+
+        QByteArray validator = reply->rawHeader("ETag");
+        if(validator.startsWith("W/")) // Weak tags are not allowed in If-Range
+            validator.clear();
+        if(validator.isEmpty())
+            validator = reply->rawHeader("Last-Modified");
+        downloadWriteValidator(unit.destination, validator);
+    }
+
+    unit.file->write(reply->readAll());
+}
+
+void DownloadScheduler::downloadProgress(qint64 received, qint64 total)
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    const QString id = idOf(reply);
+    if(id.isEmpty())
+        return;
+
+    const DownloadSchedulerUnit &unit = p->units.value(id);
+    emit progress(id, unit.offset + received, total<0? -1 : unit.offset + total);
+}
+
+void DownloadScheduler::replyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    const QString id = idOf(reply);
+    if(id.isEmpty())
+        return;
+
+    p->running--;
+    reply->deleteLater();
+
+    DownloadSchedulerUnit &unit = p->units[id];
+    unit.reply = 0;
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QNetworkReply::NetworkError error = reply->error();
+
+    if(status == 416 && unit.offset)
+    {
+        // The part doesn't fit the file on the server anymore, start over.
+        unit.file->close();
+        delete unit.file;
+        unit.file = 0;
+        downloadRemovePart(unit.destination);
+
+        retry(id, reply->errorString());
+        next();
+        return;
+    }
+    else
+    if(error != QNetworkReply::NoError || (status != 200 && status != 206))
+    {
+        unit.file->close();
+        delete unit.file;
+        unit.file = 0;
+
+        if(status >= 400 && status < 500 && status != 408 && status != 429)
+        {
+            downloadRemovePart(unit.destination);
+            p->units.remove(id);
+            emit failed(id, reply->errorString());
+        }
+        else
+            retry(id, reply->errorString());
+
+        next();
+        return;
+    }
+    else
+        unit.file->write(reply->readAll());
+
+    unit.file->close();
+    delete unit.file;
+    unit.file = 0;
+
+    const QString destination = unit.destination;
+    p->units.remove(id);
+
+    QFile::remove(destination);
+    QFile::remove(destination + DOWNLOAD_VALIDATOR_SUFFIX);
+    if(!QFile::rename(destination + DOWNLOAD_PART_SUFFIX, destination))
+    {
+        QFile::remove(destination + DOWNLOAD_PART_SUFFIX);
+        emit failed(id, "Can't move the downloaded file to " + destination);
+    }
+    else
+        emit finished(id, destination);
+
+    next();
+}
+
+void DownloadScheduler::retry(const QString &id, const QString &error)
+{
+    DownloadSchedulerUnit &unit = p->units[id];
+    if(unit.retries >= p->maximumRetries)
+    {
+        downloadRemovePart(unit.destination);
+        p->units.remove(id);
+        emit failed(id, error);
+        return;
+    }
+
+    const int delay = qMin(DOWNLOAD_RETRY_BASE_DELAY << unit.retries, DOWNLOAD_RETRY_MAX_DELAY);
+    unit.retries++;
+    unit.waiting = true;
+
+    QTimer::singleShot(delay, this, [this, id](){
+        if(!p->units.contains(id) || !p->units.value(id).waiting)
+            return;
+
+        p->units[id].waiting = false;
+        p->queue.prepend(id);
+        next();
+    });
+}
+
+DownloadScheduler::~DownloadScheduler()
+{
+    p->queue.clear();
+    p->maximumParallel = 0;
+    // Stopped, not canceled: the part files are kept to resume on next run.
+    for(const QString &id: p->units.keys())
+        stop(id);
+
+    delete p;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOWNLOADSCHEDULER_H
+#define DOWNLOADSCHEDULER_H
+
+#include <QObject>
+#include <QUrl>
+#include <QStringList>
+
+class QNetworkReply;
+class DownloadSchedulerPrivate;
+
+/*!
+ * Queues file downloads and runs at most maximumParallel() of them at once.
+ * Data is written to "<destination>.part" and renamed when complete, so an
+ * interrupted download continues with an HTTP Range request next time. The
+ * ETag or Last-Modified of the response is kept beside the part and sent as
+ * If-Range, so a file changed on the server is downloaded from the start.
+ * Network failures are retried with exponential backoff before failed() is
+ * emitted; a canceled or failed download removes its part file.
+ */
+class DownloadScheduler : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int maximumParallel READ maximumParallel WRITE setMaximumParallel NOTIFY maximumParallelChanged)
+    Q_PROPERTY(int maximumRetries READ maximumRetries WRITE setMaximumRetries NOTIFY maximumRetriesChanged)
+
+public:
+    DownloadScheduler(QObject *parent = 0);
+    ~DownloadScheduler();
+
+    void setMaximumParallel(int count);
+    int maximumParallel() const;
+
+    void setMaximumRetries(int count);
+    int maximumRetries() const;
+
+    bool contains(const QString &id) const;
+    bool isActive() const;
+
+public slots:
+    void enqueue(const QString &id, const QUrl &url, const QString &destination);
+    void cancel(const QString &id);
+
+signals:
+    void maximumParallelChanged();
+    void maximumRetriesChanged();
+    void progress(const QString &id, qint64 received, qint64 total);
+    void finished(const QString &id, const QString &destination);
+    void failed(const QString &id, const QString &error);
+
+private slots:
+    void readyRead();
+    void replyFinished();
+    void downloadProgress(qint64 received, qint64 total);
+
+private:
+    void next();
+    void start(const QString &id);
+    void stop(const QString &id);
+    void retry(const QString &id, const QString &error);
+    QString idOf(QNetworkReply *reply) const;
+
+private:
+    DownloadSchedulerPrivate *p;
+};
+
+#endif // DOWNLOADSCHEDULER_H
@@ -27,12 +27,14 @@
 #include "hashobject.h"
 #include "systeminfo.h"
 #include "stickerwriter.h"
+#include "stickerrenderer.h"
 #include "threadedsearchmodel.h"
 #include "p7zipextractor.h"
 #include "xmldownloadermodel.h"
 #include "meikade_macros.h"
 #include "networkfeatures.h"
 #include "poetimageprovider.h"
+#include "poetthumbnailcache.h"
 #include "xmldownloaderproxymodel.h"
 #include "asemantools/asemandevices.h"
 #include "asemantools/asemanquickview.h"
@@ -140,6 +142,7 @@ Meikade::Meikade(QObject *parent) :
     qmlRegisterType<PoetImageProvider>("Meikade", 1, 0, "PoetImageProvider");
     qmlRegisterType<StickerModel>("Meikade", 1, 0, "StickerModel");
     qmlRegisterType<StickerWriter>("Meikade", 1, 0, "StickerWriter");
+    qmlRegisterType<StickerRenderer>("Meikade", 1, 0, "StickerRenderer");
     qmlRegisterType<NetworkFeatures>("Meikade", 1, 0, "NetworkFeatures");
     qmlRegisterType<ThreadedSearchModel>("Meikade", 1, 0, "ThreadedSearchModel");
     qmlRegisterUncreatableType<MeikadeDatabase>("Meikade", 1, 0, "MeikadeDatabase", "");
@@ -549,9 +552,11 @@ void Meikade::start()
     p->backuper = new Backuper();
     p->system = new SystemInfo(this);
     p->devices = new AsemanDevices(this);
+    PoetThumbnailCache::instance();
 
     p->viewer = new AsemanQmlEngine();
     p->viewer->addImportPath(":/qml/");
+    p->viewer->addImageProvider("poets", new PoetThumbnailImageProvider);
     p->viewer->rootContext()->setContextProperty( "Meikade" , this );
     p->viewer->rootContext()->setContextProperty( "Database", p->poem_db  );
     p->viewer->rootContext()->setContextProperty( "UserData", p->user_db  );
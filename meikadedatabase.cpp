@@ -17,11 +17,17 @@
 */
 
 #define CURRENT_DB_VERSION 4
+#define POEMS_DATA_CACHE_SIZE 16
 
 #include "meikadedatabase.h"
 #include "threadedfilesystem.h"
 #include "meikade_macros.h"
 #include "meikade.h"
+#include "databaseconnectionpool.h"
+#include "meikadedatabasemigrator.h"
+#include "meikadedatabaseworker.h"
+#include "versecodec.h"
+#include "poemcorpus.h"
 #include "asemantools/asemanapplication.h"
 
 #include <QSqlDatabase>
@@ -33,6 +39,7 @@
 #include <QDir>
 #include <QDebug>
 #include <QThread>
+#include <QJSEngine>
 
 const QString sort_string = QString::fromUtf8("اَُِبپتثجچحخدذرزژسشصضطظعغفقکگلمنوهی");
 
@@ -75,10 +82,20 @@ public:
     bool initialized;
     int databaseLocation;
 
-    int fetchedPoem;
-    QHash<int, QHash<QString,QVariant> > fetchedPoemData;
+    QHash<int, QHash<int, QHash<QString,QVariant> > > poemsData;
+    QList<int> poemsDataOrder;
+    QHash<int, QList<int> > catPoems;
     QHash<QString,QVariant> values;
 
+    MeikadeDatabaseMigrator *migrator;
+
+    QThread *workerThread;
+    MeikadeDatabaseWorker *worker;
+    QHash<int, QJSValue> callbacks;
+    int lastRequestId;
+    // bumped by init_buffer(), results of requests made before are not cached
+    int bufferGeneration;
+
     static MeikadeDatabaseThreadedCopy *copy;
 };
 
@@ -89,7 +106,9 @@ MeikadeDatabase::MeikadeDatabase(ThreadedFileSystem *tfs, QObject *parent) :
 {
     p = new MeikadeDatabasePrivate;
     p->tfs = tfs;
-    p->fetchedPoem = -1;
+    p->migrator = 0;
+    p->lastRequestId = 0;
+    p->bufferGeneration = 0;
     p->databaseLocation = ApplicationMemoryDatabase;
 
     for(int i=ApplicationMemoryDatabase; i<=ExternalSdCardDatabase; i++)
@@ -101,8 +120,17 @@ MeikadeDatabase::MeikadeDatabase(ThreadedFileSystem *tfs, QObject *parent) :
 
     const QString dbPath = databasePath();
 
+    p->workerThread = new QThread();
+
+    p->worker = new MeikadeDatabaseWorker();
+    p->worker->moveToThread(p->workerThread);
+
+    connect( p->worker, &MeikadeDatabaseWorker::finished, this, &MeikadeDatabase::workerFinished, Qt::QueuedConnection );
+
+    p->workerThread->start();
+
 #ifndef OLD_DATABASE
-    p->initialized = true;
+    p->initialized = false;
 #ifdef Q_OS_ANDROID
     if(!QFileInfo::exists(ANDROID_OLD_DB_PATH "/data.sqlite"))
 #endif
@@ -123,7 +151,7 @@ MeikadeDatabase::MeikadeDatabase(ThreadedFileSystem *tfs, QObject *parent) :
     p->db.setDatabaseName(dbPath);
     p->db.open();
 
-    init_buffer();
+    migrate();
 #else
     p->initialized = false;
     initialize();
@@ -153,12 +181,19 @@ void MeikadeDatabase::setDatabaseLocation(int dbLocation)
         }
 
         p->db.close();
+        DatabaseConnectionPool::invalidate(source);
+        VerseCodec::invalidate(source);
+        PoemCorpus::invalidate(source);
         QFile::remove(source);
+        QFile::remove(PoemCorpus::corpusPath(source));
         p->databaseLocation = dbLocation;
+        p->poemsData.clear();
+        p->poemsDataOrder.clear();
 
         p->db.setDatabaseName(destination);
         p->db.open();
         init_buffer();
+        generateCorpus();
 
         p->copy->deleteLater();
         p->copy = 0;
@@ -212,6 +247,11 @@ bool MeikadeDatabase::copyingDatabase() const
     return p->copy;
 }
 
+bool MeikadeDatabase::migrating() const
+{
+    return p->migrator;
+}
+
 bool MeikadeDatabase::initialized() const
 {
     return p->initialized;
@@ -238,10 +278,21 @@ void MeikadeDatabase::initialize()
     p->src = "database/data/data";
 #endif
 
+    // extracting is set until an extraction completes, so an interrupted
+    // one is redone. Comparing sizes doesn't work: removing poets shrinks
+    // the file.
     int db_version = Meikade::settings()->value("initialize/dataVersion",0).toInt();
-    if( db_version < CURRENT_DB_VERSION || !QFileInfo(dbPath).exists() || QFileInfo(dbPath).size() < 105000000 )
+    bool extracting = Meikade::settings()->value("initialize/extracting",false).toBool();
+    if( db_version < CURRENT_DB_VERSION || extracting || !QFileInfo(dbPath).exists() )
     {
+        Meikade::settings()->setValue("initialize/extracting",true);
+        Meikade::settings()->sync();
+
+        DatabaseConnectionPool::invalidate(dbPath);
+        VerseCodec::invalidate(dbPath);
+        PoemCorpus::invalidate(dbPath);
         QFile::remove(dbPath);
+        QFile::remove(PoemCorpus::corpusPath(dbPath));
 
         connect( p->tfs, SIGNAL(extractProgress(int)), SIGNAL(extractProgress(int)), Qt::QueuedConnection );
         connect( p->tfs, SIGNAL(extractFinished(QString)), SLOT(initialize_prv(QString)), Qt::QueuedConnection );
@@ -251,7 +302,6 @@ void MeikadeDatabase::initialize()
     else
     {
         QMetaObject::invokeMethod( this, "initialize_prv", Qt::QueuedConnection, Q_ARG(QString,dbPath) );
-        p->initialized = true;
     }
 }
 
@@ -273,16 +323,15 @@ void MeikadeDatabase::initialize_prv(const QString &dst)
     disconnect( p->tfs, SIGNAL(extractError()), this, SIGNAL(copyError()) );
 
     Meikade::settings()->setValue("initialize/dataVersion",CURRENT_DB_VERSION);
+    Meikade::settings()->remove("initialize/extracting");
+    Meikade::settings()->remove("initialize/dataSize");
     QFile(dbPath).setPermissions(QFileDevice::ReadUser|QFileDevice::ReadGroup);
 
     p->db = QSqlDatabase::addDatabase("QSQLITE",DATA_DB_CONNECTION);
     p->db.setDatabaseName(dbPath);
     p->db.open();
 
-    p->initialized = true;
-    init_buffer();
-
-    emit initializeFinished();
+    migrate();
 }
 
 QList<int> MeikadeDatabase::rootChilds() const
@@ -309,39 +358,28 @@ QString MeikadeDatabase::catName(int id)
 
 QList<int> MeikadeDatabase::catPoems(int cat)
 {
-    QList<int> result;
-
-    QSqlQuery query( p->db );
-    query.prepare("SELECT id, title, url, cat_id FROM poem WHERE cat_id=:cat");
-    query.bindValue(":cat",cat);
-    query.exec();
+    if( !p->catPoems.contains(cat) )
+        setCatPoems(cat, MeikadeDatabaseWorker::readCatPoems(databasePath(), cat));
 
-    while( query.next() )
-    {
-        QSqlRecord record = query.record();
-        int id = record.value(0).toInt();
-        for( int i=0; i<record.count(); i++ )
-            p->poems_cache[id].insert( record.fieldName(i), record.value(i) );
-
-        result << id;
-    }
-
-    return result;
+    return p->catPoems.value(cat);
 }
 
 QString MeikadeDatabase::poemName(int id)
 {
     if( !p->poems_cache.value(id).contains("title") )
     {
-        QSqlQuery query( p->db );
-        query.prepare("SELECT title FROM poem WHERE id=:id");
+        QSqlQuery query = DatabaseConnectionPool::query(databasePath(), "SELECT title FROM poem WHERE id=:id");
         query.bindValue(":id",id);
         query.exec();
 
         if( !query.next() )
+        {
+            query.finish();
             return 0;
+        }
 
         p->poems_cache[id]["title"] = query.record().value(0).toString();
+        query.finish();
     }
 
     return p->poems_cache[id].value("title").toString();
@@ -351,15 +389,18 @@ int MeikadeDatabase::poemCat(int id)
 {
     if( !p->poems_cache.value(id).contains("cat_id") )
     {
-        QSqlQuery query( p->db );
-        query.prepare("SELECT cat_id FROM poem WHERE id=:id");
+        QSqlQuery query = DatabaseConnectionPool::query(databasePath(), "SELECT cat_id FROM poem WHERE id=:id");
         query.bindValue(":id",id);
         query.exec();
 
         if( !query.next() )
+        {
+            query.finish();
             return 0;
+        }
 
         p->poems_cache[id]["cat_id"] = query.record().value(0).toInt();
+        query.finish();
     }
 
     return p->poems_cache[id].value("cat_id").toInt();
@@ -372,15 +413,18 @@ QString MeikadeDatabase::poemPhrase(int id)
 
     if( !p->poems_cache.value(id).contains("phrase") )
     {
-        QSqlQuery query( p->db );
-        query.prepare("SELECT phrase FROM poem WHERE id=:id");
+        QSqlQuery query = DatabaseConnectionPool::query(databasePath(), "SELECT phrase FROM poem WHERE id=:id");
         query.bindValue(":id",id);
         query.exec();
 
         if( !query.next() )
+        {
+            query.finish();
             return 0;
+        }
 
         p->poems_cache[id]["phrase"] = query.record().value(0).toString();
+        query.finish();
     }
 
     return p->poems_cache[id].value("phrase").toString();
@@ -388,19 +432,14 @@ QString MeikadeDatabase::poemPhrase(int id)
 
 QList<int> MeikadeDatabase::poemVerses(int id)
 {
-    QList<int> result;
+    QSharedPointer<PoemCorpus> corpus = PoemCorpus::corpus(databasePath());
+    if(corpus && corpus->contains(id))
+        return corpus->verses(id);
 
-    QSqlQuery query( p->db );
-    query.prepare("SELECT vorder FROM verse WHERE poem_id=:id");
-    query.bindValue(":id",id);
-    query.exec();
-
-    while( query.next() )
-    {
-        QSqlRecord record = query.record();
-        result << record.value(0).toInt();
-    }
+    fetchPoem(id);
 
+    QList<int> result = p->poemsData.value(id).keys();
+    qSort( result.begin(), result.end() );
     return result;
 }
 
@@ -436,14 +475,40 @@ bool MeikadeDatabase::containsPoet(int id)
 
 QString MeikadeDatabase::verseText(int pid, int vid)
 {
+    QSharedPointer<PoemCorpus> corpus = PoemCorpus::corpus(databasePath());
+    if(corpus && corpus->contains(pid))
+        return corpus->verseText(pid, vid);
+
     fetchPoem(pid);
-    return p->fetchedPoemData[vid]["text"].toString();
+    return p->poemsData[pid][vid]["text"].toString();
 }
 
 int MeikadeDatabase::versePosition(int pid, int vid)
 {
+    QSharedPointer<PoemCorpus> corpus = PoemCorpus::corpus(databasePath());
+    if(corpus && corpus->contains(pid))
+        return corpus->versePosition(pid, vid);
+
     fetchPoem(pid);
-    return p->fetchedPoemData[vid]["position"].toInt();
+    return p->poemsData[pid][vid]["position"].toInt();
+}
+
+void MeikadeDatabase::prefetchPoem(int pid)
+{
+    QMetaObject::invokeMethod( p->worker, "request", Qt::QueuedConnection, Q_ARG(int,0), Q_ARG(int,p->bufferGeneration), Q_ARG(int,MeikadeDatabaseWorker::PrefetchPoem),
+                               Q_ARG(QString,databasePath()), Q_ARG(int,pid), Q_ARG(int,0) );
+}
+
+void MeikadeDatabase::prefetchCategory(int cat)
+{
+    foreach(int child, p->childs.values(cat))
+    {
+        if(p->catPoems.contains(child))
+            continue;
+
+        QMetaObject::invokeMethod( p->worker, "request", Qt::QueuedConnection, Q_ARG(int,0), Q_ARG(int,p->bufferGeneration), Q_ARG(int,MeikadeDatabaseWorker::CatPoems),
+                                   Q_ARG(QString,databasePath()), Q_ARG(int,child), Q_ARG(int,0) );
+    }
 }
 
 QVariant MeikadeDatabase::value(const QString &key, const QVariant &defaultValue) const
@@ -473,6 +538,7 @@ bool MeikadeDatabase::setValue(const QString &key, const QVariant &value)
 
 void MeikadeDatabase::init_buffer()
 {
+    p->bufferGeneration++;
     p->childs.clear();
     p->cats.clear();
     p->parents.clear();
@@ -481,19 +547,20 @@ void MeikadeDatabase::init_buffer()
     p->cat_poets.clear();
     p->poets_set.clear();
     p->values.clear();
-
-    do {
-        QSqlQuery generalQuery(p->db);
-        generalQuery.prepare("SELECT * FROM General");
-        if(!generalQuery.exec())
-            qDebug() << __PRETTY_FUNCTION__ << generalQuery.lastError().text();
-        else
-        while(generalQuery.next())
-        {
-            QSqlRecord record = generalQuery.record();
-            p->values[record.value("key").toString()] = record.value("value");
-        }
-    } while(checkUpdate());
+    p->catPoems.clear();
+    p->poemsData.clear();
+    p->poemsDataOrder.clear();
+
+    QSqlQuery generalQuery(p->db);
+    generalQuery.prepare("SELECT * FROM General");
+    if(!generalQuery.exec())
+        qDebug() << __PRETTY_FUNCTION__ << generalQuery.lastError().text();
+    else
+    while(generalQuery.next())
+    {
+        QSqlRecord record = generalQuery.record();
+        p->values[record.value("key").toString()] = record.value("value");
+    }
 
     QSqlQuery cats_query( p->db );
     cats_query.prepare("SELECT id, parent_id, poet_id, text, url FROM cat");
@@ -542,63 +609,231 @@ void MeikadeDatabase::init_buffer()
 
 void MeikadeDatabase::fetchPoem(int pid)
 {
-    if(p->fetchedPoem == pid)
+    if(p->poemsData.contains(pid))
+    {
+        p->poemsDataOrder.removeOne(pid);
+        p->poemsDataOrder.append(pid);
         return;
+    }
 
-    p->fetchedPoem = pid;
-    p->fetchedPoemData.clear();
+    setPoemData(pid, MeikadeDatabaseWorker::readPoem(databasePath(), pid));
+}
 
-    QSqlQuery query(p->db);
-    query.prepare("SELECT vorder, text, position FROM verse WHERE poem_id=:pid");
-    query.bindValue(":pid",pid);
-    query.exec();
+void MeikadeDatabase::setPoemData(int pid, const QVariantList &verses)
+{
+    QHash<int, QHash<QString,QVariant> > &data = p->poemsData[pid];
+    data.clear();
 
-    while( query.next() )
+    foreach(const QVariant &var, verses)
     {
-        QSqlRecord record = query.record();
-        int vorder = record.value("vorder").toInt();
-        p->fetchedPoemData[vorder]["text"] = record.value("text").toString();
-        p->fetchedPoemData[vorder]["position"] = record.value("position").toInt();
+        const QVariantMap &map = var.toMap();
+        int vorder = map.value("vorder").toInt();
+        data[vorder]["text"] = map.value("text");
+        data[vorder]["position"] = map.value("position");
     }
+
+    p->poemsDataOrder.removeOne(pid);
+    p->poemsDataOrder.append(pid);
+    while(p->poemsDataOrder.count() > POEMS_DATA_CACHE_SIZE)
+        p->poemsData.remove(p->poemsDataOrder.takeFirst());
 }
 
-bool MeikadeDatabase::checkUpdate()
+QList<int> MeikadeDatabase::setCatPoems(int cat, const QVariantList &poems)
 {
-    const int version = value("Database/version", 0).toString().toInt();
-    int dyn_version = version;
-    if(dyn_version == 0)
+    QList<int> &ids = p->catPoems[cat];
+    ids.clear();
+
+    foreach(const QVariant &var, poems)
     {
-        QStringList queries = QStringList()
-                << "PRAGMA foreign_keys = 0"
-                << "CREATE TABLE General (\"key\" TEXT PRIMARY KEY, value TEXT)"
-                << "CREATE TABLE sqlitestudio_temp_table AS SELECT * FROM poet"
-                << "DROP TABLE poet"
-                << "CREATE TABLE poet (id INTEGER PRIMARY KEY NOT NULL, name NVARCHAR (20), cat_id INTEGER, description TEXT, lastUpdate DATETIME DEFAULT NULL)"
-                << "INSERT INTO poet (id, name, cat_id, description) SELECT id, name, cat_id, description FROM sqlitestudio_temp_table"
-                << "DROP TABLE sqlitestudio_temp_table"
-                << "PRAGMA foreign_keys = 1";
-
-        foreach(const QString &q, queries)
+        const QVariantMap &map = var.toMap();
+        int id = map.value("id").toInt();
+        for(QVariantMap::const_iterator i=map.constBegin(); i!=map.constEnd(); i++)
+            p->poems_cache[id].insert( i.key(), i.value() );
+
+        ids << id;
+    }
+
+    return ids;
+}
+
+int MeikadeDatabase::catPoemsAsync(int cat, const QJSValue &callback)
+{
+    return pushRequest(MeikadeDatabaseWorker::CatPoems, cat, 0, callback);
+}
+
+int MeikadeDatabase::poemPhraseAsync(int id, const QJSValue &callback)
+{
+    return pushRequest(MeikadeDatabaseWorker::PoemPhrase, id, 0, callback);
+}
+
+int MeikadeDatabase::poemVersesAsync(int id, const QJSValue &callback)
+{
+    return pushRequest(MeikadeDatabaseWorker::PoemVerses, id, 0, callback);
+}
+
+int MeikadeDatabase::verseTextAsync(int pid, int vid, const QJSValue &callback)
+{
+    return pushRequest(MeikadeDatabaseWorker::VerseText, pid, vid, callback);
+}
+
+void MeikadeDatabase::generateCorpus()
+{
+    if(!PoemCorpus::enabled())
+        return;
+
+    QMetaObject::invokeMethod( p->worker, "request", Qt::QueuedConnection, Q_ARG(int,0), Q_ARG(int,p->bufferGeneration), Q_ARG(int,MeikadeDatabaseWorker::GenerateCorpus),
+                               Q_ARG(QString,databasePath()), Q_ARG(int,0), Q_ARG(int,0) );
+}
+
+int MeikadeDatabase::pushRequest(int type, int arg1, int arg2, const QJSValue &callback)
+{
+    const int requestId = ++p->lastRequestId;
+    if(callback.isCallable())
+        p->callbacks[requestId] = callback;
+
+    QMetaObject::invokeMethod( p->worker, "request", Qt::QueuedConnection, Q_ARG(int,requestId), Q_ARG(int,p->bufferGeneration), Q_ARG(int,type),
+                               Q_ARG(QString,databasePath()), Q_ARG(int,arg1), Q_ARG(int,arg2) );
+    return requestId;
+}
+
+void MeikadeDatabase::workerFinished(int requestId, int generation, int type, int arg1, int arg2, const QVariant &data)
+{
+    // Read before the buffers were reset (install, removal, update): still
+    // answered, but kept out of the caches.
+    const bool current = (generation == p->bufferGeneration);
+
+    QVariant result;
+    switch(type)
+    {
+    case MeikadeDatabaseWorker::CatPoems:
+    {
+        QVariantList ids;
+        if(current)
+            foreach(int id, setCatPoems(arg1, data.toList()))
+                ids << id;
+        else
+            foreach(const QVariant &var, data.toList())
+                ids << var.toMap().value("id");
+
+        result = ids;
+    }
+        break;
+
+    case MeikadeDatabaseWorker::PoemVerses:
+    {
+        QVariantList vorders;
+        foreach(const QVariant &var, data.toList())
+            vorders << var.toMap().value("vorder");
+
+        if(current)
+            setPoemData(arg1, data.toList());
+        result = vorders;
+    }
+        break;
+
+    case MeikadeDatabaseWorker::VerseText:
+        if(current)
         {
-            QSqlQuery query(p->db);
-            query.prepare(q);
-            if(!query.exec())
-                qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            setPoemData(arg1, data.toList());
+            result = p->poemsData[arg1][arg2]["text"].toString();
         }
-        dyn_version = 1;
-        qDebug() << QString("Database updated to the %1 version.").arg(dyn_version);
+        else
+        {
+            foreach(const QVariant &var, data.toList())
+                if(var.toMap().value("vorder").toInt() == arg2)
+                    result = var.toMap().value("text").toString();
+        }
+        break;
+
+    case MeikadeDatabaseWorker::PrefetchPoem:
+    {
+        if(!current)
+            break;
+
+        const QVariantMap &poems = data.toMap();
+        for(QVariantMap::const_iterator i=poems.constBegin(); i!=poems.constEnd(); i++)
+            if(!p->poemsData.contains(i.key().toInt()))
+                setPoemData(i.key().toInt(), i.value().toList());
     }
+        break;
 
-    if(dyn_version != version)
+    case MeikadeDatabaseWorker::PoemPhrase:
+        if(current)
+            p->poems_cache[arg1]["phrase"] = data.toString();
+        result = data;
+        break;
+    }
+
+    if(!requestId)
+        return;
+
+    QJSValue callback = p->callbacks.take(requestId);
+    if(callback.isCallable())
     {
-        setValue("Database/version", QString::number(dyn_version));
-        return true;
+        QJSEngine *engine = qjsEngine(this);
+        if(engine)
+            callback.call(QJSValueList() << engine->toScriptValue(result));
     }
-    else
-        return false;
+
+    Q_EMIT asyncFinished(requestId, result);
+}
+
+void MeikadeDatabase::migrate()
+{
+    if(p->migrator)
+        return;
+
+    if(MeikadeDatabaseMigrator::databaseVersion(p->db) >= MeikadeDatabaseMigrator::lastVersion())
+    {
+        p->initialized = true;
+        init_buffer();
+        generateCorpus();
+        // migrate() also runs from the constructor, before anyone could connect
+        QMetaObject::invokeMethod(this, "initializeFinished", Qt::QueuedConnection);
+        return;
+    }
+
+    p->initialized = false;
+    p->migrator = new MeikadeDatabaseMigrator();
+    connect(p->migrator, &MeikadeDatabaseMigrator::migrationProgress, this, &MeikadeDatabase::migrationProgress, Qt::QueuedConnection);
+    connect(p->migrator, &MeikadeDatabaseMigrator::migrationFinished, this, &MeikadeDatabase::migrationFinished, Qt::QueuedConnection);
+    p->migrator->migrate(databasePath());
+
+    Q_EMIT migratingChanged();
+}
+
+void MeikadeDatabase::migrationFinished(bool result)
+{
+    if(!p->migrator)
+        return;
+
+    p->migrator->wait();
+    p->migrator->deleteLater();
+    p->migrator = 0;
+
+    if(!result)
+        qDebug() << __PRETTY_FUNCTION__ << "Database migration failed, continuing with the old schema.";
+
+    p->initialized = true;
+    init_buffer();
+    generateCorpus();
+
+    Q_EMIT migratingChanged();
+    Q_EMIT initializeFinished();
 }
 
 MeikadeDatabase::~MeikadeDatabase()
 {
+    p->workerThread->quit();
+    p->workerThread->wait();
+    delete p->worker;
+    delete p->workerThread;
+
+    if(p->migrator)
+    {
+        p->migrator->wait();
+        delete p->migrator;
+    }
+
     delete p;
 }
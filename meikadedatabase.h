@@ -25,6 +25,7 @@
 #include <QDir>
 #include <QVariant>
 #include <QDateTime>
+#include <QJSValue>
 
 class ThreadedFileSystem;
 class MeikadeDatabasePrivate;
@@ -36,6 +37,7 @@ class MeikadeDatabase : public QObject
     Q_PROPERTY(int containsHafez READ containsHafez NOTIFY countChanged)
     Q_PROPERTY(int databaseLocation READ databaseLocation WRITE setDatabaseLocation NOTIFY databaseLocationChanged)
     Q_PROPERTY(bool copyingDatabase READ copyingDatabase NOTIFY copyingDatabaseChanged)
+    Q_PROPERTY(bool migrating READ migrating NOTIFY migratingChanged)
 
 public:
     enum DatabaseLocation {
@@ -58,6 +60,19 @@ public:
     static QString databasePath(int dbLocation);
 
     bool copyingDatabase() const;
+    bool migrating() const;
+
+    /*!
+     * Asynchronous variants of the lookups below. They run on the database
+     * worker thread and return a request id immediately; the result is
+     * passed to callback (if any) and emitted by asyncFinished() on the GUI
+     * thread, after it has been stored in the same caches the synchronous
+     * calls use.
+     */
+    Q_INVOKABLE int catPoemsAsync(int cat, const QJSValue &callback = QJSValue());
+    Q_INVOKABLE int poemPhraseAsync(int id, const QJSValue &callback = QJSValue());
+    Q_INVOKABLE int poemVersesAsync(int id, const QJSValue &callback = QJSValue());
+    Q_INVOKABLE int verseTextAsync(int pid, int vid, const QJSValue &callback = QJSValue());
 
 signals:
     void initializeFinished();
@@ -67,6 +82,9 @@ signals:
     void countChanged();
     void databaseLocationChanged();
     void copyingDatabaseChanged();
+    void migratingChanged();
+    void migrationProgress(int percent);
+    void asyncFinished(int requestId, const QVariant &result);
 
 public slots:
     void initialize();
@@ -94,16 +112,25 @@ public slots:
     QString verseText(int pid , int vid);
     int versePosition(int pid , int vid);
 
+    void prefetchPoem(int pid);
+    void prefetchCategory(int cat);
+
     QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
     bool setValue(const QString &key, const QVariant &value);
 
 private:
     void init_buffer();
     void fetchPoem(int pid );
-    bool checkUpdate();
+    void setPoemData(int pid, const QVariantList &verses);
+    QList<int> setCatPoems(int cat, const QVariantList &poems);
+    int pushRequest(int type, int arg1, int arg2, const QJSValue &callback);
+    void generateCorpus();
+    void migrate();
 
 private slots:
     void initialize_prv(const QString & dst);
+    void migrationFinished(bool result);
+    void workerFinished(int requestId, int generation, int type, int arg1, int arg2, const QVariant &data);
 
 private:
     MeikadeDatabasePrivate *p;
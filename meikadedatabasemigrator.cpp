@@ -0,0 +1,152 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meikadedatabasemigrator.h"
+#include "databaseconnectionpool.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QFile>
+#include <QVariant>
+#include <QDebug>
+
+QList<MeikadeDatabaseMigration> MeikadeDatabaseMigrator::migrations()
+{
+    QList<MeikadeDatabaseMigration> result;
+
+    MeikadeDatabaseMigration general;
+    general.version = 1;
+    general.name = "general-table";
+    general.queries << "CREATE TABLE IF NOT EXISTS General (\"key\" TEXT PRIMARY KEY, value TEXT)"
+                    << "DROP TABLE IF EXISTS sqlitestudio_temp_table"
+                    << "CREATE TABLE sqlitestudio_temp_table AS SELECT * FROM poet"
+                    << "DROP TABLE poet"
+                    << "CREATE TABLE poet (id INTEGER PRIMARY KEY NOT NULL, name NVARCHAR (20), cat_id INTEGER, description TEXT, lastUpdate DATETIME DEFAULT NULL)"
+                    << "INSERT INTO poet (id, name, cat_id, description) SELECT id, name, cat_id, description FROM sqlitestudio_temp_table"
+                    << "DROP TABLE sqlitestudio_temp_table";
+    result << general;
+
+    MeikadeDatabaseMigration indexes;
+    indexes.version = 2;
+    indexes.name = "covering-indexes";
+    indexes.queries << "CREATE INDEX IF NOT EXISTS verse_poem_covering ON verse(poem_id, vorder, position)"
+                    << "DROP INDEX IF EXISTS verse_pid"
+                    << "CREATE INDEX IF NOT EXISTS poem_cat_covering ON poem(cat_id, id, title, url)"
+                    << "DROP INDEX IF EXISTS poem_cid"
+                    << "CREATE INDEX IF NOT EXISTS cat_parent_covering ON cat(parent_id, id)"
+                    << "DROP INDEX IF EXISTS cat_pid"
+                    << "CREATE INDEX IF NOT EXISTS cat_poet_covering ON cat(poet_id, id)"
+                    << "CREATE INDEX IF NOT EXISTS verse_poet ON verse(poet)"
+                    << "PRAGMA analysis_limit = 1000"
+                    << "ANALYZE";
+    result << indexes;
+
+    return result;
+}
+
+int MeikadeDatabaseMigrator::lastVersion()
+{
+    return migrations().last().version;
+}
+
+int MeikadeDatabaseMigrator::databaseVersion(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT value FROM General WHERE key=:key");
+    query.bindValue(":key", "Database/version");
+    if(!query.exec() || !query.next())
+        return 0;
+
+    return query.record().value(0).toString().toInt();
+}
+
+void MeikadeDatabaseMigrator::run()
+{
+    QFile(_path).setPermissions(QFileDevice::ReadUser|QFileDevice::WriteUser|
+                                QFileDevice::ReadGroup|QFileDevice::WriteGroup);
+
+    QSqlDatabase db = DatabaseConnectionPool::database(_path, DatabaseConnectionPool::ReadWrite);
+    if(!db.isOpen())
+    {
+        Q_EMIT migrationFinished(false);
+        return;
+    }
+
+    const int version = databaseVersion(db);
+
+    QList<MeikadeDatabaseMigration> pending;
+    int total = 0;
+    for(const MeikadeDatabaseMigration &step: migrations())
+        if(step.version > version)
+        {
+            pending << step;
+            total += step.queries.count() + 1;
+        }
+
+    int done = 0;
+    for(const MeikadeDatabaseMigration &step: pending)
+    {
+        if(step.transaction)
+            db.transaction();
+
+        bool failed = false;
+        for(const QString &q: step.queries)
+        {
+            QSqlQuery query(db);
+            if(!query.exec(q))
+            {
+                qDebug() << __PRETTY_FUNCTION__ << step.name << query.lastError().text();
+                failed = true;
+                break;
+            }
+
+            done++;
+            Q_EMIT migrationProgress(done*100/total);
+        }
+
+        if(!failed)
+        {
+            QSqlQuery query(db);
+            query.prepare("INSERT OR REPLACE INTO General (key,value) VALUES (:key, :value)");
+            query.bindValue(":key", "Database/version");
+            query.bindValue(":value", QString::number(step.version));
+            failed = !query.exec();
+            if(failed)
+                qDebug() << __PRETTY_FUNCTION__ << step.name << query.lastError().text();
+        }
+
+        if(failed)
+        {
+            if(step.transaction)
+                db.rollback();
+
+            Q_EMIT migrationFinished(false);
+            return;
+        }
+
+        if(step.transaction)
+            db.commit();
+
+        done++;
+        Q_EMIT migrationProgress(done*100/total);
+        qDebug() << QString("Database updated to the %1 version.").arg(step.version);
+    }
+
+    Q_EMIT migrationFinished(true);
+}
@@ -0,0 +1,70 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEIKADEDATABASEMIGRATOR_H
+#define MEIKADEDATABASEMIGRATOR_H
+
+#include <QThread>
+#include <QStringList>
+#include <QSqlDatabase>
+
+class MeikadeDatabaseMigration
+{
+public:
+    MeikadeDatabaseMigration(): version(0), transaction(true) {}
+
+    int version;
+    QString name;
+    QStringList queries;
+    bool transaction;
+};
+
+/*!
+ * Brings data.sqlite up to lastVersion() on its own thread. Steps run in
+ * order and each one stores its version in the General table inside its
+ * own transaction, so an interrupted upgrade resumes from the last
+ * committed step on the next start.
+ */
+class MeikadeDatabaseMigrator : public QThread
+{
+    Q_OBJECT
+public:
+    void migrate(const QString &path) {
+        if(isRunning())
+            return;
+
+        _path = path;
+        start();
+    }
+
+    static QList<MeikadeDatabaseMigration> migrations();
+    static int lastVersion();
+    static int databaseVersion(QSqlDatabase db);
+
+signals:
+    void migrationProgress(int percent);
+    void migrationFinished(bool result);
+
+protected:
+    void run();
+
+private:
+    QString _path;
+};
+
+#endif // MEIKADEDATABASEMIGRATOR_H
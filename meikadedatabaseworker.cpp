@@ -0,0 +1,148 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meikadedatabaseworker.h"
+#include "databaseconnectionpool.h"
+#include "versecodec.h"
+#include "poemcorpus.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QVariantMap>
+
+MeikadeDatabaseWorker::MeikadeDatabaseWorker(QObject *parent) :
+    QObject(parent)
+{
+}
+
+QVariantList MeikadeDatabaseWorker::readCatPoems(const QString &path, int cat)
+{
+    QVariantList result;
+
+    QSqlQuery query = DatabaseConnectionPool::query(path, "SELECT id, title, url, cat_id FROM poem WHERE cat_id=:cat");
+    query.bindValue(":cat",cat);
+    query.exec();
+
+    while( query.next() )
+    {
+        QSqlRecord record = query.record();
+        QVariantMap map;
+        for( int i=0; i<record.count(); i++ )
+            map[record.fieldName(i)] = record.value(i);
+
+        result << map;
+    }
+
+    query.finish();
+    return result;
+}
+
+QVariantList MeikadeDatabaseWorker::readPoem(const QString &path, int pid)
+{
+    QSharedPointer<PoemCorpus> corpus = PoemCorpus::corpus(path);
+    if(corpus && corpus->contains(pid))
+        return corpus->poem(pid);
+
+    QVariantList result;
+    const VerseCodec codec = VerseCodec::codec(path);
+
+    QSqlQuery query = DatabaseConnectionPool::query(path, "SELECT vorder, text, position FROM verse WHERE poem_id=:pid");
+    query.bindValue(":pid",pid);
+    query.exec();
+
+    while( query.next() )
+    {
+        QSqlRecord record = query.record();
+        QVariantMap map;
+        map["vorder"] = record.value(0).toInt();
+        map["text"] = codec.decode(record.value(1).toString());
+        map["position"] = record.value(2).toInt();
+
+        result << map;
+    }
+
+    query.finish();
+    return result;
+}
+
+QString MeikadeDatabaseWorker::readPoemPhrase(const QString &path, int pid)
+{
+    QSqlQuery query = DatabaseConnectionPool::query(path, "SELECT phrase FROM poem WHERE id=:id");
+    query.bindValue(":id",pid);
+    query.exec();
+
+    QString result;
+    if( query.next() )
+        result = query.record().value(0).toString();
+
+    query.finish();
+    return result;
+}
+
+void MeikadeDatabaseWorker::request(int requestId, int generation, int type, const QString &path, int arg1, int arg2)
+{
+    QVariant result;
+    switch(type)
+    {
+    case CatPoems:
+        result = readCatPoems(path, arg1);
+        break;
+
+    case PoemVerses:
+    case VerseText:
+        result = readPoem(path, arg1);
+        break;
+
+    case PoemPhrase:
+        result = readPoemPhrase(path, arg1);
+        break;
+
+    case PrefetchPoem:
+    {
+        QSqlQuery query = DatabaseConnectionPool::query(path, "SELECT cat_id FROM poem WHERE id=:id");
+        query.bindValue(":id",arg1);
+        query.exec();
+        const int cat = query.next()? query.record().value(0).toInt() : -1;
+        query.finish();
+
+        QList<int> siblings;
+        foreach(const QVariant &var, readCatPoems(path, cat))
+            siblings << var.toMap().value("id").toInt();
+
+        QVariantMap poems;
+        const int idx = siblings.indexOf(arg1);
+        if(idx > 0)
+            poems[QString::number(siblings.at(idx-1))] = readPoem(path, siblings.at(idx-1));
+        if(idx != -1 && idx+1 < siblings.count())
+            poems[QString::number(siblings.at(idx+1))] = readPoem(path, siblings.at(idx+1));
+
+        result = poems;
+    }
+        break;
+
+    case GenerateCorpus:
+        result = PoemCorpus::generate(path);
+        break;
+    }
+
+    Q_EMIT finished(requestId, generation, type, arg1, arg2, result);
+}
+
+MeikadeDatabaseWorker::~MeikadeDatabaseWorker()
+{
+}
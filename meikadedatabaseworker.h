@@ -0,0 +1,52 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEIKADEDATABASEWORKER_H
+#define MEIKADEDATABASEWORKER_H
+
+#include <QObject>
+#include <QVariant>
+
+class MeikadeDatabaseWorker : public QObject
+{
+    Q_OBJECT
+public:
+    enum RequestType {
+        CatPoems,
+        PoemVerses,
+        PoemPhrase,
+        VerseText,
+        PrefetchPoem,
+        GenerateCorpus
+    };
+
+    MeikadeDatabaseWorker(QObject *parent = 0);
+    ~MeikadeDatabaseWorker();
+
+    static QVariantList readCatPoems(const QString &path, int cat);
+    static QVariantList readPoem(const QString &path, int pid);
+    static QString readPoemPhrase(const QString &path, int pid);
+
+public slots:
+    void request(int requestId, int generation, int type, const QString &path, int arg1, int arg2);
+
+signals:
+    void finished(int requestId, int generation, int type, int arg1, int arg2, const QVariant &result);
+};
+
+#endif // MEIKADEDATABASEWORKER_H
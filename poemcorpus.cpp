@@ -0,0 +1,483 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define POEM_CORPUS_MAGIC "MKCORPUS"
+#define POEM_CORPUS_VERSION 2
+#define POEM_CORPUS_REVISION_KEY "Corpus/revision"
+
+#include "poemcorpus.h"
+#include "databaseconnectionpool.h"
+#include "versecodec.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QVector>
+#include <QUuid>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QDebug>
+
+#include <cstring>
+
+class PoemCorpusHeader
+{
+public:
+    char magic[8];
+    quint32 version;
+    quint32 count;
+    char revision[40];
+};
+
+class PoemCorpusPoem
+{
+public:
+    qint32 id;
+    qint32 poet;
+    quint32 versesCount;
+    quint32 reserved;
+    qint64 offset;
+    qint64 end;
+};
+
+class PoemCorpusVerse
+{
+public:
+    qint32 vorder;
+    qint32 position;
+    quint32 length;
+};
+
+static QMutex poem_corpus_mutex;
+static QMutex poem_corpus_generate_mutex;
+static QHash<QString, QSharedPointer<PoemCorpus> > poem_corpus_cache;
+
+static inline qint64 poemCorpusVerseSize(quint32 length)
+{
+    const qint64 size = sizeof(PoemCorpusVerse) + length*sizeof(ushort);
+    return (size + 3) & ~qint64(3);
+}
+
+PoemCorpus::PoemCorpus() :
+    _data(0),
+    _size(0),
+    _poems(0),
+    _count(0)
+{
+}
+
+QString PoemCorpus::corpusPath(const QString &dbPath)
+{
+    return dbPath + ".corpus";
+}
+
+QSharedPointer<PoemCorpus> PoemCorpus::corpus(const QString &dbPath)
+{
+    QMutexLocker locker(&poem_corpus_mutex);
+    if(poem_corpus_cache.contains(dbPath))
+        return poem_corpus_cache.value(dbPath);
+
+    QSharedPointer<PoemCorpus> result;
+    if(enabled() && QFileInfo::exists(dbPath))
+    {
+        result = QSharedPointer<PoemCorpus>(new PoemCorpus);
+        if(!result->open(corpusPath(dbPath), revision(dbPath)))
+            result.clear();
+    }
+
+    poem_corpus_cache[dbPath] = result;
+    return result;
+}
+
+void PoemCorpus::invalidate(const QString &dbPath)
+{
+    QMutexLocker locker(&poem_corpus_mutex);
+    poem_corpus_cache.remove(dbPath);
+}
+
+bool PoemCorpus::enabled()
+{
+#ifdef POEM_CORPUS
+    return true;
+#else
+    return false;
+#endif
+}
+
+QByteArray PoemCorpus::revision(const QString &dbPath)
+{
+    QSqlQuery query = DatabaseConnectionPool::query(dbPath, "SELECT value FROM General WHERE key=:key");
+    query.bindValue(":key", POEM_CORPUS_REVISION_KEY);
+
+    QByteArray result;
+    if(query.exec() && query.next())
+        result = query.value(0).toString().toLatin1();
+
+    query.finish();
+    return result;
+}
+
+bool PoemCorpus::touch(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO General (key,value) VALUES (:key, :value)");
+    query.bindValue(":key", POEM_CORPUS_REVISION_KEY);
+    query.bindValue(":value", QUuid::createUuid().toString());
+    if(query.exec())
+        return true;
+
+    qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+    return false;
+}
+
+bool PoemCorpus::open(const QString &path, const QByteArray &revision)
+{
+    _file.setFileName(path);
+    if(!_file.open(QFile::ReadOnly))
+        return false;
+
+    _size = _file.size();
+    if(_size < static_cast<qint64>(sizeof(PoemCorpusHeader)))
+        return false;
+
+    _data = _file.map(0, _size);
+    if(!_data)
+        return false;
+
+    const PoemCorpusHeader *header = reinterpret_cast<const PoemCorpusHeader*>(_data);
+    if(qstrncmp(header->magic, POEM_CORPUS_MAGIC, sizeof(header->magic)) != 0 ||
+       header->version != POEM_CORPUS_VERSION ||
+       qstrncmp(header->revision, revision.constData(), sizeof(header->revision)) != 0)
+        return false;
+    if(sizeof(PoemCorpusHeader) + static_cast<qint64>(header->count)*sizeof(PoemCorpusPoem) > static_cast<quint64>(_size))
+        return false;
+
+    _poems = reinterpret_cast<const PoemCorpusPoem*>(_data + sizeof(PoemCorpusHeader));
+    _count = header->count;
+    return true;
+}
+
+bool PoemCorpus::generate(const QString &dbPath)
+{
+    if(!enabled())
+        return false;
+
+    QMutexLocker locker(&poem_corpus_generate_mutex);
+
+    invalidate(dbPath);
+    if(corpus(dbPath))
+        return true;
+
+    const QFileInfo db(dbPath);
+    if(!db.exists())
+        return false;
+
+    PoemCorpusHeader header;
+    memcpy(header.magic, POEM_CORPUS_MAGIC, sizeof(header.magic));
+    header.version = POEM_CORPUS_VERSION;
+    header.count = 0;
+    memset(header.revision, 0, sizeof(header.revision));
+    const QByteArray &revision = PoemCorpus::revision(dbPath);
+    memcpy(header.revision, revision.constData(), qMin<int>(revision.size(), sizeof(header.revision)-1));
+
+    const VerseCodec codec = VerseCodec::codec(dbPath);
+    QSqlDatabase sqlDb = DatabaseConnectionPool::database(dbPath);
+
+    QSqlQuery count_query(sqlDb);
+    if(!count_query.exec("SELECT COUNT(DISTINCT poem_id) FROM verse") || !count_query.next())
+    {
+        qDebug() << __PRETTY_FUNCTION__ << count_query.lastError().text();
+        return false;
+    }
+    header.count = count_query.value(0).toUInt();
+    count_query.finish();
+
+    const QString path = corpusPath(dbPath);
+    QFile file(path + "." + QUuid::createUuid().toString().remove('{').remove('}') + ".tmp");
+    if(!file.open(QFile::WriteOnly))
+        return false;
+
+    QVector<PoemCorpusPoem> poems;
+    poems.reserve(header.count);
+
+    qint64 offset = sizeof(PoemCorpusHeader) + static_cast<qint64>(header.count)*sizeof(PoemCorpusPoem);
+    file.seek(offset);
+
+    QSqlQuery query(sqlDb);
+    query.setForwardOnly(true);
+    if(!query.exec("SELECT poem_id, vorder, position, text, poet FROM verse ORDER BY poem_id, vorder"))
+    {
+        qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+        file.remove();
+        return false;
+    }
+
+    const char padding[4] = {0, 0, 0, 0};
+    while(query.next())
+    {
+        const int poemId = query.value(0).toInt();
+        if(poems.isEmpty() || poems.last().id != poemId)
+        {
+            if(!poems.isEmpty())
+                poems.last().end = offset;
+
+            PoemCorpusPoem poem;
+            poem.id = poemId;
+            poem.poet = query.value(4).toInt();
+            poem.versesCount = 0;
+            poem.reserved = 0;
+            poem.offset = offset;
+            poem.end = offset;
+            poems << poem;
+        }
+
+        const QString text = codec.decode(query.value(3).toString());
+
+        PoemCorpusVerse verse;
+        verse.vorder = query.value(1).toInt();
+        verse.position = query.value(2).toInt();
+        verse.length = text.length();
+
+        const qint64 textSize = text.length()*sizeof(ushort);
+        const qint64 recordSize = poemCorpusVerseSize(verse.length);
+        file.write(reinterpret_cast<const char*>(&verse), sizeof(PoemCorpusVerse));
+        file.write(reinterpret_cast<const char*>(text.constData()), textSize);
+        file.write(padding, recordSize - sizeof(PoemCorpusVerse) - textSize);
+
+        poems.last().versesCount++;
+        offset += recordSize;
+    }
+    query.finish();
+
+    if(!poems.isEmpty())
+        poems.last().end = offset;
+
+    header.count = poems.count();
+    file.seek(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(PoemCorpusHeader));
+    file.write(reinterpret_cast<const char*>(poems.constData()), poems.count()*sizeof(PoemCorpusPoem));
+
+    const bool failed = (file.error() != QFile::NoError);
+    file.close();
+    if(failed)
+    {
+        qDebug() << __PRETTY_FUNCTION__ << file.errorString();
+        file.remove();
+        return false;
+    }
+
+    QFile::remove(path);
+    const bool result = file.rename(path);
+    if(!result)
+        file.remove();
+
+    invalidate(dbPath);
+    return result;
+}
+
+int PoemCorpus::count() const
+{
+    return _count;
+}
+
+bool PoemCorpus::contains(int pid) const
+{
+    return find(pid);
+}
+
+const PoemCorpusPoem *PoemCorpus::find(int pid) const
+{
+    int begin = 0;
+    int end = _count;
+    while(begin < end)
+    {
+        const int mid = (begin + end)/2;
+        const PoemCorpusPoem *poem = _poems + mid;
+        if(poem->id == pid)
+            return poem;
+        else
+        if(poem->id < pid)
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+
+    return 0;
+}
+
+const uchar *PoemCorpus::verseAt(const PoemCorpusPoem *poem, qint64 offset) const
+{
+    if(offset < poem->offset || offset + static_cast<qint64>(sizeof(PoemCorpusVerse)) > poem->end || poem->end > _size)
+        return 0;
+
+    const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(_data + offset);
+    if(offset + poemCorpusVerseSize(verse->length) > poem->end)
+        return 0;
+
+    return _data + offset;
+}
+
+QList<int> PoemCorpus::verses(int pid) const
+{
+    QList<int> result;
+    const PoemCorpusPoem *poem = find(pid);
+    if(!poem)
+        return result;
+
+    qint64 offset = poem->offset;
+    for(quint32 i=0; i<poem->versesCount; i++)
+    {
+        const uchar *data = verseAt(poem, offset);
+        if(!data)
+            break;
+
+        const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(data);
+        result << verse->vorder;
+        offset += poemCorpusVerseSize(verse->length);
+    }
+
+    return result;
+}
+
+QString PoemCorpus::verseText(int pid, int vid) const
+{
+    const PoemCorpusPoem *poem = find(pid);
+    if(!poem)
+        return QString();
+
+    qint64 offset = poem->offset;
+    for(quint32 i=0; i<poem->versesCount; i++)
+    {
+        const uchar *data = verseAt(poem, offset);
+        if(!data)
+            break;
+
+        const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(data);
+        if(verse->vorder == vid)
+            return QString(reinterpret_cast<const QChar*>(data + sizeof(PoemCorpusVerse)), verse->length);
+
+        offset += poemCorpusVerseSize(verse->length);
+    }
+
+    return QString();
+}
+
+int PoemCorpus::versePosition(int pid, int vid) const
+{
+    const PoemCorpusPoem *poem = find(pid);
+    if(!poem)
+        return 0;
+
+    qint64 offset = poem->offset;
+    for(quint32 i=0; i<poem->versesCount; i++)
+    {
+        const uchar *data = verseAt(poem, offset);
+        if(!data)
+            break;
+
+        const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(data);
+        if(verse->vorder == vid)
+            return verse->position;
+
+        offset += poemCorpusVerseSize(verse->length);
+    }
+
+    return 0;
+}
+
+QVariantList PoemCorpus::poem(int pid) const
+{
+    QVariantList result;
+    const PoemCorpusPoem *poem = find(pid);
+    if(!poem)
+        return result;
+
+    qint64 offset = poem->offset;
+    for(quint32 i=0; i<poem->versesCount; i++)
+    {
+        const uchar *data = verseAt(poem, offset);
+        if(!data)
+            break;
+
+        const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(data);
+
+        QVariantMap map;
+        map["vorder"] = verse->vorder;
+        map["text"] = QString(reinterpret_cast<const QChar*>(data + sizeof(PoemCorpusVerse)), verse->length);
+        map["position"] = verse->position;
+        result << map;
+
+        offset += poemCorpusVerseSize(verse->length);
+    }
+
+    return result;
+}
+
+bool PoemCorpus::findNext(const QString &keyword, int poet, PoemCorpusCursor &cursor, int &poemId, int &vorder,
+                          const bool *cancel, const bool *reset) const
+{
+    while(cursor.poem < _count)
+    {
+        if((cancel && *cancel) || (reset && *reset))
+            return false;
+
+        const PoemCorpusPoem *poem = _poems + cursor.poem;
+        if(poet != -1 && poem->poet != poet)
+        {
+            cursor.poem++;
+            cursor.verse = 0;
+            continue;
+        }
+
+        if(cursor.verse == 0)
+            cursor.offset = poem->offset;
+
+        while(cursor.verse < static_cast<int>(poem->versesCount))
+        {
+            const uchar *data = verseAt(poem, cursor.offset);
+            if(!data)
+                break;
+
+            const PoemCorpusVerse *verse = reinterpret_cast<const PoemCorpusVerse*>(data);
+            cursor.offset += poemCorpusVerseSize(verse->length);
+            cursor.verse++;
+
+            const QString text = QString::fromRawData(reinterpret_cast<const QChar*>(data + sizeof(PoemCorpusVerse)), verse->length);
+            if(text.contains(keyword, Qt::CaseInsensitive))
+            {
+                poemId = poem->id;
+                vorder = verse->vorder;
+                return true;
+            }
+        }
+
+        cursor.poem++;
+        cursor.verse = 0;
+    }
+
+    return false;
+}
+
+PoemCorpus::~PoemCorpus()
+{
+    if(_data)
+        _file.unmap(const_cast<uchar*>(_data));
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POEMCORPUS_H
+#define POEMCORPUS_H
+
+#include <QString>
+#include <QFile>
+#include <QVariant>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+
+class PoemCorpusCursor
+{
+public:
+    PoemCorpusCursor(): poem(0), verse(0), offset(0) {}
+
+    int poem;
+    int verse;
+    qint64 offset;
+};
+
+class PoemCorpusPoem;
+
+/*!
+ * Read-only copy of the verse table, written next to data.sqlite and mapped
+ * into memory. The file starts with a header, followed by a table of poems
+ * sorted by id and the verses of every poem as (vorder, position, length)
+ * records followed by their UTF-16 text. The header stores the content
+ * revision of the database it was made from (the General key
+ * 'Corpus/revision', renewed by touch() whenever verses or poets change); a
+ * corpus of another revision is ignored until it is generated again.
+ *
+ * The corpus costs about the size of the database on disk, so it is only
+ * generated and used when built with POEM_CORPUS defined.
+ */
+class PoemCorpus
+{
+public:
+    ~PoemCorpus();
+
+    static bool enabled();
+    static QString corpusPath(const QString &dbPath);
+    static QByteArray revision(const QString &dbPath);
+    static bool touch(QSqlDatabase db);
+    static QSharedPointer<PoemCorpus> corpus(const QString &dbPath);
+    static void invalidate(const QString &dbPath);
+    static bool generate(const QString &dbPath);
+
+    int count() const;
+    bool contains(int pid) const;
+
+    QList<int> verses(int pid) const;
+    QString verseText(int pid, int vid) const;
+    int versePosition(int pid, int vid) const;
+    QVariantList poem(int pid) const;
+
+    /*! Continues a case-insensitive search from cursor. The matched texts are
+     *  never copied out of the mapped file. Stops early once any of the
+     *  cancel flags is set. */
+    bool findNext(const QString &keyword, int poet, PoemCorpusCursor &cursor,
+                  int &poemId, int &vorder, const bool *cancel = 0, const bool *reset = 0) const;
+
+private:
+    PoemCorpus();
+    bool open(const QString &path, const QByteArray &revision);
+    const PoemCorpusPoem *find(int pid) const;
+    const uchar *verseAt(const PoemCorpusPoem *poem, qint64 offset) const;
+
+private:
+    QFile _file;
+    const uchar *_data;
+    qint64 _size;
+    const PoemCorpusPoem *_poems;
+    int _count;
+};
+
+#endif // POEMCORPUS_H
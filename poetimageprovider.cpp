@@ -16,28 +16,16 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#define THUMB_WEB_LINK QString("http://aseman.land/download/meikade/2/thumbs/%1.png").arg(p->poet)
-#define THUMB_QRC_LINK QString(":/qml/Meikade/poets/%1.png").arg(p->poet)
-#define THUMB_DNL_LINK QString(p->downloadPath+"/%1.png").arg(p->poet)
-#define THUMB_DEFAULT QString(":/qml/Meikade/poets/default.png")
-
 #include "poetimageprovider.h"
-#include "asemantools/asemandownloader.h"
-#include "asemantools/asemanapplication.h"
-#include "meikade_macros.h"
+#include "poetthumbnailcache.h"
 
-#include <QPointer>
-#include <QFileInfo>
-#include <QDir>
+#define THUMB_DEFAULT QString(":/qml/Meikade/poets/default.png")
 
 class PoetImageProviderPrivate
 {
 public:
     int poet;
     QUrl path;
-    QString downloadPath;
-
-    QPointer<AsemanDownloader> downloader;
 };
 
 PoetImageProvider::PoetImageProvider(QObject *parent) :
@@ -45,9 +33,8 @@ PoetImageProvider::PoetImageProvider(QObject *parent) :
 {
     p = new PoetImageProviderPrivate;
     p->poet = 0;
-    p->downloadPath = HOME_PATH + "/thumbs/poets";
 
-    QDir().mkpath(p->downloadPath);
+    connect(PoetThumbnailCache::instance(), &PoetThumbnailCache::ready, this, &PoetImageProvider::thumbnailReady);
 }
 
 void PoetImageProvider::setPoet(int poet)
@@ -73,51 +60,31 @@ QUrl PoetImageProvider::path() const
 
 void PoetImageProvider::refresh()
 {
-    if(p->downloader)
-        return;
     if(!p->poet)
         return;
 
+    PoetThumbnailCache *cache = PoetThumbnailCache::instance();
+
     QUrl result;
-    if(QFileInfo::exists(THUMB_QRC_LINK))
-        result = "qrc" + THUMB_QRC_LINK;
-    else
-    if(QFileInfo::exists(THUMB_DNL_LINK))
-        result = QUrl::fromLocalFile(THUMB_DNL_LINK);
+    if(!cache->localPath(p->poet).isEmpty())
+        result = QString("image://poets/%1").arg(p->poet);
     else
     {
-        p->downloader = new AsemanDownloader(this);
-        p->downloader->setPath(THUMB_WEB_LINK);
-        p->downloader->setDestination(THUMB_DNL_LINK);
-
-        connect(p->downloader, SIGNAL(finished(QByteArray)), SLOT(finished(QByteArray)));
-
-        p->downloader->start();
+        cache->request(p->poet);
         result = "qrc" + THUMB_DEFAULT;
     }
 
+    if(p->path == result)
+        return;
+
     p->path = result;
     emit pathChanged();
 }
 
-void PoetImageProvider::finished(const QByteArray &data)
+void PoetImageProvider::thumbnailReady(int poet)
 {
-    Q_UNUSED(data)
-
-    if(p->downloader)
-    {
-        p->downloader->deleteLater();
-        p->downloader = 0;
-    }
-
-    QUrl result;
-    if(QFileInfo::exists(THUMB_DNL_LINK))
-        result = QUrl::fromLocalFile(THUMB_DNL_LINK);
-    else
-        return;
-
-    p->path = result;
-    emit pathChanged();
+    if(poet == p->poet)
+        refresh();
 }
 
 PoetImageProvider::~PoetImageProvider()
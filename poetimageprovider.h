@@ -46,7 +46,7 @@ signals:
     void pathChanged();
 
 private slots:
-    void finished( const QByteArray & data );
+    void thumbnailReady(int poet);
 
 private:
     PoetImageProviderPrivate *p;
@@ -23,8 +23,17 @@
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlRecord>
+#include <QStringList>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QThread>
 #include <QDebug>
 
+#include <functional>
+
+#define POET_REMOVER_VACUUM_PAGES "256"
+#define POET_REMOVER_INDEX_STEP 2000
+
 namespace PoetRemover {
 
 void begin(QSqlDatabase & db)
@@ -41,50 +50,14 @@ void commit(QSqlDatabase & db)
     query.exec();
 }
 
-void removePoem( QSqlDatabase & db, int poem_id )
-{
-    QSqlQuery delete_verse_query(db);
-    delete_verse_query.prepare("DELETE FROM verse WHERE poem_id=:pid");
-    delete_verse_query.bindValue(":pid", poem_id);
-    delete_verse_query.exec();
-}
-
-void removeCatChild( QSqlDatabase & db, int parent_id )
+void rollback(QSqlDatabase & db)
 {
     QSqlQuery query(db);
-    query.prepare("SELECT id FROM cat WHERE parent_id=:pid");
-    query.bindValue(":pid", parent_id);
+    query.prepare("ROLLBACK");
     query.exec();
-
-    while( query.next() )
-    {
-        int id = query.record().value(0).toInt();
-        removeCatChild( db, id );
-    }
-
-    QSqlQuery poem_query(db);
-    poem_query.prepare("SELECT id FROM poem WHERE cat_id=:cid");
-    poem_query.bindValue(":cid", parent_id);
-    poem_query.exec();
-
-    while( poem_query.next() )
-    {
-        int id = poem_query.record().value(0).toInt();
-        removePoem( db, id );
-    }
-
-    QSqlQuery delete_poem_query(db);
-    delete_poem_query.prepare("DELETE FROM poem WHERE cat_id=:cid");
-    delete_poem_query.bindValue(":cid", parent_id);
-    delete_poem_query.exec();
-
-    QSqlQuery delete_cat_query(db);
-    delete_cat_query.prepare("DELETE FROM cat WHERE parent_id=:pid");
-    delete_cat_query.bindValue(":pid", parent_id);
-    delete_cat_query.exec();
 }
 
-void removePoetCat( QSqlDatabase & db, int poet_id )
+bool removePoetCat( QSqlDatabase & db, int poet_id )
 {
     QSqlQuery poetName(db);
     poetName.prepare("SELECT name FROM poet WHERE id=:pid");
@@ -92,79 +65,150 @@ void removePoetCat( QSqlDatabase & db, int poet_id )
     poetName.exec();
 
     if(!poetName.next())
-        return;
+        return true;
+    poetName.finish();
 
     begin(db);
 
-    QSqlQuery query(db);
-    query.prepare("SELECT id FROM cat WHERE poet_id=:pid");
-    query.bindValue(":pid", poet_id);
-    query.exec();
+    const QStringList queries = QStringList()
+            << "CREATE TEMP TABLE IF NOT EXISTS removed_cats (id INTEGER PRIMARY KEY)"
+            << "DELETE FROM temp.removed_cats"
+            << "INSERT INTO temp.removed_cats "
+               "WITH RECURSIVE tree(id) AS (SELECT id FROM cat WHERE poet_id=:pid "
+               "UNION SELECT cat.id FROM cat JOIN tree ON cat.parent_id=tree.id) "
+               "SELECT id FROM tree"
+            << "DELETE FROM verse WHERE poem_id IN (SELECT id FROM poem WHERE cat_id IN (SELECT id FROM temp.removed_cats))"
+            << "DELETE FROM poem WHERE cat_id IN (SELECT id FROM temp.removed_cats)"
+            << "DELETE FROM cat WHERE id IN (SELECT id FROM temp.removed_cats)"
+            << "DELETE FROM poet WHERE id=:pid"
+            << "DELETE FROM temp.removed_cats";
+
+    foreach(const QString &q, queries)
+    {
+        QSqlQuery query(db);
+        query.prepare(q);
+        if(q.contains(":pid"))
+            query.bindValue(":pid", poet_id);
+
+        if(!query.exec())
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            rollback(db);
+            return false;
+        }
+    }
+
+    commit(db);
+    return true;
+}
+
+/*!
+ * Rebuilds verse.poet from the poem and cat tables. The poem to poet mapping
+ * is built once in a temporary table and the verses are updated from it in
+ * ranges of poem ids, so progress can be reported between the ranges.
+ */
+bool indexVersesPoets(QSqlDatabase & db, std::function<void(int)> progress = std::function<void(int)>())
+{
+    begin(db);
 
-    while( query.next() )
+    const QStringList queries = QStringList()
+            << "CREATE TEMP TABLE IF NOT EXISTS poem_poets (poem_id INTEGER PRIMARY KEY, poet INTEGER)"
+            << "DELETE FROM temp.poem_poets"
+            << "INSERT OR REPLACE INTO temp.poem_poets (poem_id, poet) "
+               "SELECT poem.id, cat.poet_id FROM poem JOIN cat ON cat.id=poem.cat_id";
+
+    foreach(const QString &q, queries)
+    {
+        QSqlQuery query(db);
+        if(!query.exec(q))
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            rollback(db);
+            return false;
+        }
+    }
+
+    QSqlQuery range(db);
+    if(!range.exec("SELECT MIN(poem_id), MAX(poem_id) FROM verse") || !range.next())
     {
-        int id = query.record().value(0).toInt();
-        removeCatChild( db, id );
+        qDebug() << __PRETTY_FUNCTION__ << range.lastError().text();
+        rollback(db);
+        return false;
     }
 
-    QSqlQuery delete_cat_query(db);
-    delete_cat_query.prepare("DELETE FROM cat WHERE poet_id=:pid");
-    delete_cat_query.bindValue(":pid", poet_id);
-    delete_cat_query.exec();
+    const qint64 first = range.record().value(0).toLongLong();
+    const qint64 last = range.record().value(1).toLongLong();
+    range.finish();
+
+    QSqlQuery update(db);
+    update.prepare("UPDATE verse SET poet=IFNULL((SELECT poet FROM temp.poem_poets WHERE poem_id=verse.poem_id), -1) "
+                   "WHERE poem_id BETWEEN :from AND :to");
+    for(qint64 from=first; from<=last; from+=POET_REMOVER_INDEX_STEP)
+    {
+        update.bindValue(":from", from);
+        update.bindValue(":to", from+POET_REMOVER_INDEX_STEP-1);
+        if(!update.exec())
+        {
+            qDebug() << __PRETTY_FUNCTION__ << update.lastError().text();
+            rollback(db);
+            return false;
+        }
+
+        if(progress)
+            progress(static_cast<int>((from-first)*100/(last-first+1)));
+    }
 
-    QSqlQuery delete_poet_query(db);
-    delete_poet_query.prepare("DELETE FROM poet WHERE id=:id");
-    delete_poet_query.bindValue(":id", poet_id);
-    delete_poet_query.exec();
+    QSqlQuery clear(db);
+    clear.exec("DELETE FROM temp.poem_poets");
 
     commit(db);
-}
+    if(progress)
+        progress(100);
 
-void setPoemPoet(QSqlDatabase & db, int poem, int poet)
-{
-    QSqlQuery query(db);
-    query.prepare("UPDATE verse SET poet=:poet WHERE poem_id=:poem_id");
-    query.bindValue(":poem_id", poem);
-    query.bindValue(":poet", poet);
-    query.exec();
+    return true;
 }
 
-int findCatPoet(QSqlDatabase & db, int cid)
+int pragmaValue(QSqlDatabase & db, const QString &pragma)
 {
     QSqlQuery query(db);
-    query.prepare("SELECT poet_id FROM cat WHERE id=:id");
-    query.bindValue(":id", cid);
-    query.exec();
-
-    if(!query.next())
+    if(!query.exec("PRAGMA " + pragma) || !query.next())
         return -1;
 
     return query.record().value(0).toInt();
 }
 
-void indexVersesPoets(QSqlDatabase & db)
+/*!
+ * Gives the free pages back to the file system. Databases in incremental
+ * auto vacuum mode are shrunk a few pages at a time. Older databases are
+ * switched to that mode by one full VACUUM, but only if there is room for
+ * the temporary copy it needs; otherwise the free pages are left to be
+ * reused by the next install.
+ */
+void vacuum(QSqlDatabase & db)
 {
-    QSqlQuery query(db);
-    query.prepare("SELECT id, cat_id FROM poem");
-    query.exec();
+    if(pragmaValue(db, "auto_vacuum") != 2)
+    {
+        const qint64 size = QFileInfo(db.databaseName()).size();
+        const QStorageInfo storage(QFileInfo(db.databaseName()).absolutePath());
+        if(storage.bytesAvailable() < 2*size)
+            return;
+
+        QSqlQuery query(db);
+        query.exec("PRAGMA auto_vacuum = INCREMENTAL");
+        query.exec("VACUUM");
+        return;
+    }
 
-    while( query.next() )
+    while(pragmaValue(db, "freelist_count") > 0)
     {
-        QSqlRecord record = query.record();
-        int id  = record.value(0).toInt();
-        int cid = record.value(1).toInt();
-        int pid = findCatPoet(db, cid);
+        QSqlQuery query(db);
+        if(!query.exec("PRAGMA incremental_vacuum(" POET_REMOVER_VACUUM_PAGES ")"))
+            break;
+        while(query.next()) {}
 
-        setPoemPoet(db, id, pid);
+        QThread::msleep(1);
     }
 }
-
-void vacuum(QSqlDatabase & db)
-{
-    QSqlQuery query(db);
-    query.prepare("VACUUM");
-    query.exec();
-}
 }
 
 #endif // POETREMOVER_H
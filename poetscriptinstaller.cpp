@@ -21,6 +21,8 @@
 #include "asemantools/asemanapplication.h"
 #include "meikade_macros.h"
 #include "poetremover.h"
+#include "databaseconnectionpool.h"
+#include "poemcorpus.h"
 
 #include <QDir>
 #include <QUuid>
@@ -34,7 +36,6 @@
 class PoetScriptInstallerPrivate
 {
 public:
-    P7ZipExtractor *p7zip;
     QSqlDatabase db;
     QString path;
 };
@@ -43,7 +44,6 @@ PoetScriptInstaller::PoetScriptInstaller(QObject *parent) :
     QObject(parent)
 {
     p = new PoetScriptInstallerPrivate;
-    p->p7zip = 0;
 
 #ifdef Q_OS_ANDROID
     p->path = ANDROID_OLD_DB_PATH "/data.sqlite";
@@ -54,70 +54,211 @@ PoetScriptInstaller::PoetScriptInstaller(QObject *parent) :
 #endif
 }
 
-void PoetScriptInstaller::installFile(const QString &path, int poetId, const QDateTime &date, bool removeFile)
+QString PoetScriptInstaller::revisionKey(int poetId)
 {
-    if(!p->p7zip)
-        p->p7zip = new P7ZipExtractor(this);
+    return QString("Poet/%1/revision").arg(poetId);
+}
+
+PoetScriptPackage PoetScriptInstaller::prepare(const QString &path, bool delta, bool removeFile)
+{
+    PoetScriptPackage package;
 
     const QString &tmp = AsemanApplication::tempPath();
     const QString tmpDir = tmp + "/" + QUuid::createUuid().toString();
 
-    p->p7zip->extract(path, tmpDir);
+    P7ZipExtractor p7zip;
+    p7zip.extract(path, tmpDir);
     if(removeFile)
         QFile::remove(path);
 
-    QFile file(tmpDir + "/script.sql");
-    if(!file.open(QFile::ReadOnly))
+    QFile deltaFile(tmpDir + "/delta.sql");
+    QFile scriptFile(tmpDir + "/script.sql");
+
+    QFile *file = (delta && deltaFile.exists())? &deltaFile : &scriptFile;
+    if(file->open(QFile::ReadOnly))
     {
-        emit finished(true);
-        file.remove();
-        return;
+        package.valid = true;
+        package.delta = (file == &deltaFile);
+        package.statements = splitScript(QString::fromUtf8(file->readAll()));
+        file->close();
     }
 
-    install(file.readAll(), poetId, date);
-    file.close();
-    file.remove();
-
+    deltaFile.remove();
+    scriptFile.remove();
     QDir().rmdir(tmpDir);
-    emit finished(false);
+    return package;
 }
 
-void PoetScriptInstaller::install(const QString &scr, int poetId, const QDateTime &date)
+QStringList PoetScriptInstaller::splitScript(const QString &scr)
 {
+    QStringList result;
     QString script = QString(scr).replace("\r\n", "\n");
-    initDb();
-    PoetRemover::removePoetCat(p->db, poetId);
 
     int pos = 0;
     int from = 0;
     while( (pos=script.indexOf(";\n", from)) != -1 )
     {
-        const QString &scr = script.mid(from, pos-from);
+        result << script.mid(from, pos-from);
+        from = pos+2;
+    }
+
+    return result;
+}
+
+void PoetScriptInstaller::installFile(const QString &path, int poetId, const QDateTime &date, const QString &guid,
+                                      const QString &base, bool removeFile)
+{
+    installPackage(prepare(path, !base.isEmpty(), removeFile), poetId, date, guid, base);
+}
 
+void PoetScriptInstaller::installPackage(const PoetScriptPackage &package, int poetId, const QDateTime &date,
+                                         const QString &guid, const QString &base)
+{
+    if(!package.valid)
+    {
+        emit finished(true);
+        return;
+    }
+
+    bool result = true;
+    if(package.delta)
+        result = applyDelta(package.statements, poetId, date, guid, base);
+    else
+        installStatements(package.statements, poetId, date, guid);
+
+    emit finished(!result);
+}
+
+void PoetScriptInstaller::install(const QString &script, int poetId, const QDateTime &date, const QString &guid)
+{
+    installStatements(splitScript(script), poetId, date, guid);
+}
+
+void PoetScriptInstaller::installStatements(const QStringList &statements, int poetId, const QDateTime &date, const QString &guid)
+{
+    initDb();
+    PoetRemover::removePoetCat(p->db, poetId);
+
+    PoetRemover::begin(p->db);
+    execStatements(statements, false);
+    setRevision(poetId, date, guid);
+    PoetRemover::commit(p->db);
+}
+
+/*!
+ * Applies a delta package: row level INSERT, UPDATE and DELETE statements,
+ * separated like the full scripts, that turn the base revision of the poet
+ * into the new one. Nothing is changed unless the installed revision is the
+ * base and every statement succeeds.
+ */
+bool PoetScriptInstaller::applyDelta(const QStringList &statements, int poetId, const QDateTime &date, const QString &guid, const QString &base)
+{
+    initDb();
+
+    QSqlQuery query(p->db);
+    query.prepare("SELECT value FROM General WHERE key=:key");
+    query.bindValue(":key", revisionKey(poetId));
+    if(!query.exec() || !query.next() || query.record().value(0).toString() != base)
+    {
+        qDebug() << __PRETTY_FUNCTION__ << "Installed revision doesn't match the delta base" << base;
+        return false;
+    }
+    query.finish();
+
+    PoetRemover::begin(p->db);
+    if(!execStatements(statements, true) || !setRevision(poetId, date, guid))
+    {
+        PoetRemover::rollback(p->db);
+        return false;
+    }
+
+    PoetRemover::commit(p->db);
+    return true;
+}
+
+bool PoetScriptInstaller::execStatements(const QStringList &statements, bool stopOnError)
+{
+    for(const QString &scr: statements)
+    {
         QSqlQuery query(p->db);
         query.prepare(scr);
         int res = query.exec();
         if(!res)
+        {
             qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
-
-        from = pos+2;
+            if(stopOnError)
+                return false;
+        }
     }
 
+    return true;
+}
+
+bool PoetScriptInstaller::setRevision(int poetId, const QDateTime &date, const QString &guid)
+{
     QSqlQuery query(p->db);
     query.prepare("UPDATE poet SET lastUpdate=:date WHERE id=:id");
     query.bindValue(":id", poetId);
     query.bindValue(":date", date);
     int res = query.exec();
     if(!res)
+    {
         qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+        return false;
+    }
+
+    if(!PoemCorpus::touch(p->db))
+        return false;
+
+    if(guid.isEmpty())
+        return true;
+
+    QSqlQuery revision(p->db);
+    revision.prepare("INSERT OR REPLACE INTO General (key,value) VALUES (:key, :value)");
+    revision.bindValue(":key", revisionKey(poetId));
+    revision.bindValue(":value", guid);
+    if(!revision.exec())
+    {
+        qDebug() << __PRETTY_FUNCTION__ << revision.lastError().text();
+        return false;
+    }
+
+    return true;
 }
 
 void PoetScriptInstaller::remove(int poetId)
 {
     initDb();
-    PoetRemover::removePoetCat(p->db, poetId);
+    const bool result = PoetRemover::removePoetCat(p->db, poetId);
+    if(result)
+    {
+        QSqlQuery query(p->db);
+        query.prepare("DELETE FROM General WHERE key=:key");
+        query.bindValue(":key", revisionKey(poetId));
+        query.exec();
+        PoemCorpus::touch(p->db);
+    }
+
+    emit finished(!result);
+
     PoetRemover::vacuum(p->db);
-    emit finished(false);
+}
+
+void PoetScriptInstaller::indexVersesPoets()
+{
+    initDb();
+    const bool result = PoetRemover::indexVersesPoets(p->db, [this](int percent){
+        emit indexProgress(percent);
+    });
+    if(result)
+        PoemCorpus::touch(p->db);
+
+    emit finished(!result);
+}
+
+void PoetScriptInstaller::generateCorpus()
+{
+    PoemCorpus::generate(p->path);
 }
 
 void PoetScriptInstaller::initDb()
@@ -125,12 +266,8 @@ void PoetScriptInstaller::initDb()
     QFile(p->path).setPermissions(QFileDevice::ReadUser|QFileDevice::WriteUser|
                                   QFileDevice::ReadGroup|QFileDevice::WriteGroup);
 
-    if(p->db.isOpen())
-        return;
-
-    p->db = QSqlDatabase::addDatabase("QSQLITE", QUuid::createUuid().toString());
-    p->db.setDatabaseName(p->path);
-    p->db.open();
+    p->db = DatabaseConnectionPool::database(p->path, DatabaseConnectionPool::ReadWrite);
+    PoemCorpus::invalidate(p->path);
 }
 
 PoetScriptInstaller::~PoetScriptInstaller()
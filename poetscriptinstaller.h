@@ -21,6 +21,20 @@
 
 #include <QDateTime>
 #include <QObject>
+#include <QStringList>
+#include <QMetaType>
+
+class PoetScriptPackage
+{
+public:
+    PoetScriptPackage(): valid(false), delta(false) {}
+
+    bool valid;
+    bool delta;
+    QStringList statements;
+};
+
+Q_DECLARE_METATYPE(PoetScriptPackage)
 
 class PoetScriptInstallerPrivate;
 class PoetScriptInstaller : public QObject
@@ -30,16 +44,33 @@ public:
     PoetScriptInstaller(QObject *parent = 0);
     ~PoetScriptInstaller();
 
+    static QString revisionKey(int poetId);
+
+    /*! Extracts a package and splits its script. Doesn't touch the database,
+     *  so several packages may be prepared in parallel with an install. */
+    static PoetScriptPackage prepare(const QString &path, bool delta, bool removeFile = true);
+    static QStringList splitScript(const QString &script);
+
 public slots:
-    void installFile(const QString &path, int poetId, const QDateTime &date, bool removeFile = true);
-    void install(const QString &script, int poetId, const QDateTime &date);
+    void installFile(const QString &path, int poetId, const QDateTime &date, const QString &guid = QString(),
+                     const QString &base = QString(), bool removeFile = true);
+    void installPackage(const PoetScriptPackage &package, int poetId, const QDateTime &date,
+                        const QString &guid = QString(), const QString &base = QString());
+    void install(const QString &script, int poetId, const QDateTime &date, const QString &guid = QString());
+    bool applyDelta(const QStringList &statements, int poetId, const QDateTime &date, const QString &guid, const QString &base);
     void remove(int poetId);
+    void generateCorpus();
+    void indexVersesPoets();
 
 signals:
     void finished(bool error);
+    void indexProgress(int percent);
 
 private:
     void initDb();
+    void installStatements(const QStringList &statements, int poetId, const QDateTime &date, const QString &guid);
+    bool execStatements(const QStringList &statements, bool stopOnError);
+    bool setRevision(int poetId, const QDateTime &date, const QString &guid);
 
 private:
     PoetScriptInstallerPrivate *p;
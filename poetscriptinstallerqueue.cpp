@@ -18,8 +18,13 @@
 
 #include "poetscriptinstallerqueue.h"
 #include "poetscriptinstaller.h"
+#include "poemcorpus.h"
 
 #include <QThread>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QSet>
 #include <QDebug>
 
 class PoetScriptInstallerQueueUnit
@@ -27,13 +32,15 @@ class PoetScriptInstallerQueueUnit
 public:
     enum Type {
         Install,
-        Remove
+        Remove,
+        Reindex
     };
 
     PoetScriptInstallerQueueUnit(): poetId(0), type(Install){}
 
     QString file;
     QString guid;
+    QString base;
     int poetId;
     QDateTime date;
     int type;
@@ -49,9 +56,14 @@ public:
     PoetScriptInstaller *core;
     QThread *thread;
     bool active;
+    bool corpusDirty;
 
     QList<PoetScriptInstallerQueueUnit> list;
     PoetScriptInstallerQueueUnit current;
+
+    QThreadPool *pool;
+    QHash<QString, QFutureWatcher<PoetScriptPackage>*> preparing;
+    QHash<QString, PoetScriptPackage> prepared;
 };
 
 PoetScriptInstallerQueue::PoetScriptInstallerQueue(QObject *parent) :
@@ -61,6 +73,12 @@ PoetScriptInstallerQueue::PoetScriptInstallerQueue(QObject *parent) :
     p->core = 0;
     p->thread = 0;
     p->active = false;
+    p->corpusDirty = false;
+
+    p->pool = new QThreadPool(this);
+    p->pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()-1));
+
+    qRegisterMetaType<PoetScriptPackage>("PoetScriptPackage");
 }
 
 bool PoetScriptInstallerQueue::isActive()
@@ -81,14 +99,16 @@ void PoetScriptInstallerQueue::init_core()
     p->thread->start();
 
     connect(p->core, &PoetScriptInstaller::finished, this, &PoetScriptInstallerQueue::finishedSlt, Qt::QueuedConnection);
+    connect(p->core, &PoetScriptInstaller::indexProgress, this, &PoetScriptInstallerQueue::reindexProgress, Qt::QueuedConnection);
 }
 
-void PoetScriptInstallerQueue::append(const QString &file, const QString &guid, int poetId, const QDateTime &date)
+void PoetScriptInstallerQueue::append(const QString &file, const QString &guid, int poetId, const QDateTime &date, const QString &base)
 {
     init_core();
     PoetScriptInstallerQueueUnit unit;
     unit.file = file;
     unit.guid = guid;
+    unit.base = base;
     unit.poetId = poetId;
     unit.date = date;
     unit.type = PoetScriptInstallerQueueUnit::Install;
@@ -100,6 +120,41 @@ void PoetScriptInstallerQueue::append(const QString &file, const QString &guid,
     next();
 }
 
+void PoetScriptInstallerQueue::prepare(const PoetScriptInstallerQueueUnit &unit)
+{
+    if(p->preparing.contains(unit.guid) || p->prepared.contains(unit.guid))
+        return;
+
+    const QString guid = unit.guid;
+    QFutureWatcher<PoetScriptPackage> *watcher = new QFutureWatcher<PoetScriptPackage>(this);
+    connect(watcher, &QFutureWatcher<PoetScriptPackage>::finished, this, [this, watcher, guid](){
+        p->preparing.remove(guid);
+        p->prepared[guid] = watcher->result();
+        watcher->deleteLater();
+        next();
+    });
+
+    p->preparing[guid] = watcher;
+    watcher->setFuture(QtConcurrent::run(p->pool, &PoetScriptInstaller::prepare, unit.file, !unit.base.isEmpty(), true));
+}
+
+/*!
+ * A prepared package holds the whole script in memory, so only as many
+ * packages as the pool has threads are prepared or waiting for the writer
+ * at once. They are taken in queue order, so the first queued install is
+ * always among them.
+ */
+void PoetScriptInstallerQueue::prepareAhead()
+{
+    const int limit = p->pool->maxThreadCount();
+    for(int i=0; i<p->list.count() && p->preparing.count()+p->prepared.count() < limit; i++)
+    {
+        const PoetScriptInstallerQueueUnit &unit = p->list.at(i);
+        if(unit.type == PoetScriptInstallerQueueUnit::Install)
+            prepare(unit);
+    }
+}
+
 void PoetScriptInstallerQueue::remove(const QString &guid, int poetId)
 {
     init_core();
@@ -115,6 +170,20 @@ void PoetScriptInstallerQueue::remove(const QString &guid, int poetId)
     next();
 }
 
+void PoetScriptInstallerQueue::reindex()
+{
+    init_core();
+    PoetScriptInstallerQueueUnit unit;
+    unit.guid = "reindex";
+    unit.type = PoetScriptInstallerQueueUnit::Reindex;
+
+    if(p->list.contains(unit))
+        return;
+
+    p->list << unit;
+    next();
+}
+
 void PoetScriptInstallerQueue::finishedSlt(bool error)
 {
     switch(p->current.type)
@@ -132,41 +201,88 @@ void PoetScriptInstallerQueue::finishedSlt(bool error)
         else
             emit PoetScriptInstallerQueue::removed(p->current.guid);
         break;
+
+    case PoetScriptInstallerQueueUnit::Reindex:
+        emit PoetScriptInstallerQueue::reindexFinished(error);
+        break;
     }
 
     p->current = PoetScriptInstallerQueueUnit();
+    p->corpusDirty = true;
     next();
 }
 
+/*!
+ * Packages are extracted and parsed on the thread pool ahead of the writer
+ * (see prepareAhead()); the installer thread is the only writer and takes
+ * the first unit that is ready, without overtaking an earlier unit of the
+ * same poet.
+ */
 void PoetScriptInstallerQueue::next()
 {
-    p->active = false;
+    prepareAhead();
     if(!p->current.guid.isEmpty())
         return;
+
+    p->active = false;
     if(p->list.isEmpty())
+    {
+        if(p->corpusDirty && PoemCorpus::enabled())
+            QMetaObject::invokeMethod(p->core, "generateCorpus", Qt::QueuedConnection);
+
+        p->corpusDirty = false;
         return;
+    }
 
     p->active = true;
-    p->current = p->list.takeFirst();
+
+    int idx = -1;
+    QSet<int> waitingPoets;
+    for(int i=0; i<p->list.count(); i++)
+    {
+        const PoetScriptInstallerQueueUnit &unit = p->list.at(i);
+        const bool ready = (unit.type != PoetScriptInstallerQueueUnit::Install || p->prepared.contains(unit.guid));
+        if(ready && !waitingPoets.contains(unit.poetId))
+        {
+            idx = i;
+            break;
+        }
+
+        waitingPoets.insert(unit.poetId);
+    }
+    if(idx == -1)
+        return;
+
+    p->current = p->list.takeAt(idx);
 
     switch(p->current.type)
     {
     case PoetScriptInstallerQueueUnit::Install:
-        QMetaObject::invokeMethod(p->core, "installFile", Qt::QueuedConnection,
-                                  Q_ARG(QString,p->current.file),
+        QMetaObject::invokeMethod(p->core, "installPackage", Qt::QueuedConnection,
+                                  Q_ARG(PoetScriptPackage,p->prepared.take(p->current.guid)),
                                   Q_ARG(int,p->current.poetId),
-                                  Q_ARG(QDateTime,p->current.date));
+                                  Q_ARG(QDateTime,p->current.date),
+                                  Q_ARG(QString,p->current.guid),
+                                  Q_ARG(QString,p->current.base));
         break;
 
     case PoetScriptInstallerQueueUnit::Remove:
         QMetaObject::invokeMethod(p->core, "remove", Qt::QueuedConnection,
                                   Q_ARG(int,p->current.poetId));
         break;
+
+    case PoetScriptInstallerQueueUnit::Reindex:
+        QMetaObject::invokeMethod(p->core, "indexVersesPoets", Qt::QueuedConnection);
+        break;
     }
+
+    prepareAhead();
 }
 
 PoetScriptInstallerQueue::~PoetScriptInstallerQueue()
 {
+    p->pool->waitForDone();
+
     if(p->thread && p->core)
     {
         p->thread->quit();
@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QDateTime>
 
+class PoetScriptInstallerQueueUnit;
 class PoetScriptInstallerQueuePrivate;
 class PoetScriptInstallerQueue : public QObject
 {
@@ -33,14 +34,17 @@ public:
     bool isActive();
 
 public slots:
-    void append(const QString &file, const QString &guid, int poetId, const QDateTime &date);
+    void append(const QString &file, const QString &guid, int poetId, const QDateTime &date, const QString &base = QString());
     void remove(const QString &guid, int poetId);
+    void reindex();
 
 signals:
     void error(const QString &file, const QString &guid);
     void finished(const QString &file, const QString &guid);
     void removed(const QString &guid);
     void removeError(const QString &guid);
+    void reindexProgress(int percent);
+    void reindexFinished(bool error);
 
 private slots:
     void finishedSlt(bool error);
@@ -48,6 +52,8 @@ private slots:
 private:
     void next();
     void init_core();
+    void prepare(const PoetScriptInstallerQueueUnit &unit);
+    void prepareAhead();
 
 private:
     PoetScriptInstallerQueuePrivate *p;
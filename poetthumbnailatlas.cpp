@@ -0,0 +1,208 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define THUMB_ATLAS_MAGIC "MKATLAS"
+#define THUMB_ATLAS_VERSION 1
+#define THUMB_ATLAS_CELL 128
+#define THUMB_ATLAS_SHEET 1024
+#define THUMB_ATLAS_PADDING 1
+
+#include "poetthumbnailatlas.h"
+
+#include <QImageReader>
+#include <QSaveFile>
+#include <QPainter>
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include <algorithm>
+
+PoetThumbnailAtlas::PoetThumbnailAtlas()
+{
+}
+
+/*!
+ * Packs every "<poet>.png" of the source directory into shelves of
+ * THUMB_ATLAS_SHEET sized sheets. Thumbnails bigger than a
+ * THUMB_ATLAS_CELL square are scaled down first. The returned atlas
+ * already holds the sheets, so it can be used without reading the files.
+ */
+PoetThumbnailAtlas PoetThumbnailAtlas::generate(const QString &sourceDir, const QString &destination)
+{
+    PoetThumbnailAtlas atlas;
+
+    QList< QPair<int,QImage> > thumbs;
+    const QStringList &files = QDir(sourceDir).entryList(QStringList() << "*.png", QDir::Files);
+    for(const QString &file: files)
+    {
+        bool ok = false;
+        const int poet = file.left(file.length()-4).toInt(&ok);
+        if(!ok)
+            continue;
+
+        QImageReader reader(sourceDir + "/" + file);
+        const QSize &size = reader.size();
+        if(size.width() > THUMB_ATLAS_CELL || size.height() > THUMB_ATLAS_CELL)
+            reader.setScaledSize(size.scaled(THUMB_ATLAS_CELL, THUMB_ATLAS_CELL, Qt::KeepAspectRatio));
+
+        const QImage &image = reader.read();
+        if(!image.isNull())
+            thumbs << qMakePair(poet, image);
+    }
+
+    std::stable_sort(thumbs.begin(), thumbs.end(), [](const QPair<int,QImage> &a, const QPair<int,QImage> &b){
+        return a.second.height() > b.second.height();
+    });
+
+    QPainter painter;
+    int x = 0, y = 0, shelf = 0;
+    for(const QPair<int,QImage> &thumb: thumbs)
+    {
+        const QSize &size = thumb.second.size() + QSize(THUMB_ATLAS_PADDING, THUMB_ATLAS_PADDING);
+        if(x + size.width() > THUMB_ATLAS_SHEET)
+        {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        if(atlas.sheets.isEmpty() || y + size.height() > THUMB_ATLAS_SHEET)
+        {
+            if(painter.isActive())
+                painter.end();
+
+            QImage sheet(THUMB_ATLAS_SHEET, THUMB_ATLAS_SHEET, QImage::Format_ARGB32_Premultiplied);
+            sheet.fill(Qt::transparent);
+            atlas.sheets << sheet;
+
+            painter.begin(&atlas.sheets.last());
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            x = 0;
+            y = 0;
+            shelf = 0;
+        }
+
+        Entry entry;
+        entry.sheet = atlas.sheets.count()-1;
+        entry.rect = QRect(QPoint(x, y), thumb.second.size());
+        painter.drawImage(entry.rect.topLeft(), thumb.second);
+        atlas.entries[thumb.first] = entry;
+
+        x += size.width();
+        shelf = qMax(shelf, size.height());
+    }
+    if(painter.isActive())
+        painter.end();
+
+    for(int i=0; i<atlas.sheets.count(); i++)
+    {
+        QSaveFile file(QString(destination + "-%1.png").arg(i));
+        if(!file.open(QSaveFile::WriteOnly) || !atlas.sheets.at(i).save(&file, "PNG") || !file.commit())
+        {
+            qDebug() << __PRETTY_FUNCTION__ << "Can't write atlas sheet" << file.fileName();
+            return atlas;
+        }
+    }
+
+    QSaveFile index(destination + ".index");
+    if(!index.open(QSaveFile::WriteOnly))
+        return atlas;
+
+    QTextStream stream(&index);
+    stream << THUMB_ATLAS_MAGIC << " " << THUMB_ATLAS_VERSION << " " << atlas.sheets.count() << "\n";
+    for(auto i=atlas.entries.constBegin(); i!=atlas.entries.constEnd(); i++)
+    {
+        const QRect &rect = i.value().rect;
+        stream << i.key() << " " << i.value().sheet << " " << rect.x() << " " << rect.y() << " "
+               << rect.width() << " " << rect.height() << "\n";
+    }
+    stream.flush();
+    index.commit();
+
+    return atlas;
+}
+
+bool PoetThumbnailAtlas::load(const QString &destination)
+{
+    sheets.clear();
+    entries.clear();
+
+    QFile index(destination + ".index");
+    if(!index.open(QFile::ReadOnly))
+        return false;
+
+    QTextStream stream(&index);
+    QString magic;
+    int version = 0;
+    int sheetsCount = 0;
+    stream >> magic >> version >> sheetsCount;
+    if(magic != THUMB_ATLAS_MAGIC || version != THUMB_ATLAS_VERSION)
+        return false;
+
+    for(int i=0; i<sheetsCount; i++)
+    {
+        QImage sheet(QString(destination + "-%1.png").arg(i));
+        if(sheet.isNull())
+        {
+            sheets.clear();
+            return false;
+        }
+
+        sheets << sheet.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    while(!stream.atEnd())
+    {
+        int poet = 0, x = 0, y = 0, w = 0, h = 0;
+        Entry entry;
+        stream >> poet >> entry.sheet >> x >> y >> w >> h;
+        if(stream.status() != QTextStream::Ok || entry.sheet < 0 || entry.sheet >= sheets.count())
+            break;
+
+        entry.rect = QRect(x, y, w, h);
+        entries[poet] = entry;
+        stream.skipWhiteSpace();
+    }
+
+    return true;
+}
+
+bool PoetThumbnailAtlas::isNull() const
+{
+    return sheets.isEmpty();
+}
+
+int PoetThumbnailAtlas::count() const
+{
+    return entries.count();
+}
+
+bool PoetThumbnailAtlas::contains(int poet) const
+{
+    return entries.contains(poet);
+}
+
+QImage PoetThumbnailAtlas::image(int poet) const
+{
+    if(!entries.contains(poet))
+        return QImage();
+
+    const Entry &entry = entries.value(poet);
+    return sheets.at(entry.sheet).copy(entry.rect);
+}
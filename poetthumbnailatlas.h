@@ -0,0 +1,58 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POETTHUMBNAILATLAS_H
+#define POETTHUMBNAILATLAS_H
+
+#include <QImage>
+#include <QList>
+#include <QHash>
+#include <QRect>
+
+/*!
+ * A few texture sheets holding every poet thumbnail, with an id to
+ * rectangle index. Files are "<destination>-<n>.png" and
+ * "<destination>.index".
+ */
+class PoetThumbnailAtlas
+{
+public:
+    PoetThumbnailAtlas();
+
+    static PoetThumbnailAtlas generate(const QString &sourceDir, const QString &destination);
+
+    bool load(const QString &destination);
+    bool isNull() const;
+    int count() const;
+
+    bool contains(int poet) const;
+    QImage image(int poet) const;
+
+private:
+    class Entry {
+    public:
+        Entry(): sheet(0) {}
+        int sheet;
+        QRect rect;
+    };
+
+    QList<QImage> sheets;
+    QHash<int, Entry> entries;
+};
+
+#endif // POETTHUMBNAILATLAS_H
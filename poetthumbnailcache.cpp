@@ -0,0 +1,314 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define THUMB_WEB_LINK QString("http://aseman.land/download/meikade/2/thumbs/%1.png")
+#define THUMB_DEFAULT QString(":/qml/Meikade/poets/default.png")
+#define THUMB_CACHE_COST (8*1024*1024)
+#define THUMB_ATLAS_DELAY 5000
+#define THUMB_RETRY_BASE_DELAY 30000
+#define THUMB_RETRY_MAX_DELAY (60*60*1000)
+
+#include "poetthumbnailcache.h"
+#include "poetthumbnailatlas.h"
+#include "meikade_macros.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCoreApplication>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCache>
+#include <QHash>
+#include <QDir>
+#include <QTimer>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+class PoetThumbnailFailure
+{
+public:
+    PoetThumbnailFailure(): retryTime(0), count(0) {}
+    qint64 retryTime;
+    int count;
+};
+
+class PoetThumbnailCachePrivate
+{
+public:
+    QMutex mutex;
+    bool indexed;
+    QHash<int, QString> files;
+    QCache<QString, QImage> images;
+
+    PoetThumbnailAtlas atlas;
+    bool atlasLoaded;
+    QTimer *atlasTimer;
+    QFutureWatcher<PoetThumbnailAtlas> *atlasWatcher;
+
+    QNetworkAccessManager *network;
+    QHash<QNetworkReply*, int> downloads;
+    QHash<int, PoetThumbnailFailure> failed;
+};
+
+PoetThumbnailCache::PoetThumbnailCache(QObject *parent) :
+    QObject(parent)
+{
+    p = new PoetThumbnailCachePrivate;
+    p->indexed = false;
+    p->images.setMaxCost(THUMB_CACHE_COST);
+    p->network = new QNetworkAccessManager(this);
+    p->atlasLoaded = false;
+
+    p->atlasTimer = new QTimer(this);
+    p->atlasTimer->setInterval(THUMB_ATLAS_DELAY);
+    p->atlasTimer->setSingleShot(true);
+
+    p->atlasWatcher = new QFutureWatcher<PoetThumbnailAtlas>(this);
+
+    connect(p->atlasTimer, &QTimer::timeout, this, &PoetThumbnailCache::generateAtlas);
+    connect(p->atlasWatcher, &QFutureWatcher<PoetThumbnailAtlas>::finished, this, &PoetThumbnailCache::atlasFinished);
+
+    QDir().mkpath(downloadPath());
+}
+
+PoetThumbnailCache *PoetThumbnailCache::instance()
+{
+    static PoetThumbnailCache *cache = new PoetThumbnailCache(QCoreApplication::instance());
+    return cache;
+}
+
+QString PoetThumbnailCache::downloadPath()
+{
+    return HOME_PATH + "/thumbs/poets";
+}
+
+QString PoetThumbnailCache::atlasPath()
+{
+    return HOME_PATH + "/thumbs/atlas";
+}
+
+void PoetThumbnailCache::initIndex()
+{
+    if(p->indexed)
+        return;
+
+    const QString &path = downloadPath();
+    const QStringList &entries = QDir(path).entryList(QStringList() << "*.png", QDir::Files);
+    for(const QString &entry: entries)
+    {
+        bool ok = false;
+        const int poet = entry.left(entry.length()-4).toInt(&ok);
+        if(ok)
+            p->files[poet] = path + "/" + entry;
+    }
+
+    p->indexed = true;
+}
+
+QString PoetThumbnailCache::localPath(int poet)
+{
+    QMutexLocker locker(&p->mutex);
+    initIndex();
+    return p->files.value(poet);
+}
+
+void PoetThumbnailCache::initAtlas()
+{
+    if(p->atlasLoaded)
+        return;
+
+    p->atlas.load(atlasPath());
+    p->atlasLoaded = true;
+
+    for(auto i=p->files.constBegin(); i!=p->files.constEnd(); i++)
+        if(!p->atlas.contains(i.key()))
+        {
+            QMetaObject::invokeMethod(p->atlasTimer, "start", Qt::QueuedConnection);
+            break;
+        }
+}
+
+/*!
+ * True when image needs no upscaling to fill requested with the aspect ratio
+ * kept. A zero dimension of requested is unconstrained.
+ */
+static bool thumbnailCovers(const QSize &image, const QSize &requested)
+{
+    if(!requested.isValid())
+        return true;
+    if(requested.width() > 0 && requested.height() > 0)
+        return requested.width() <= image.width() || requested.height() <= image.height();
+    if(requested.width() > 0)
+        return requested.width() <= image.width();
+
+    return requested.height() <= image.height();
+}
+
+QImage PoetThumbnailCache::image(int poet, const QSize &requestedSize, QSize *size)
+{
+    p->mutex.lock();
+    initIndex();
+    initAtlas();
+    const QImage &atlasImage = p->atlas.image(poet);
+    p->mutex.unlock();
+
+    // A sheet copy is cheap; a separate png decode per poet is not. Cells are
+    // THUMB_ATLAS_CELL wide though, so larger (high density) requests decode
+    // the original file to stay sharp.
+    if(!atlasImage.isNull() && thumbnailCovers(atlasImage.size(), requestedSize))
+    {
+        QImage result = atlasImage;
+        if(requestedSize.isValid() && (result.width() > requestedSize.width() || result.height() > requestedSize.height()))
+            result = result.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        if(size)
+            *size = result.size();
+        return result;
+    }
+
+    QString path = localPath(poet);
+    if(path.isEmpty())
+        path = THUMB_DEFAULT;
+
+    const QString &key = QString("%1:%2x%3").arg(path).arg(requestedSize.width()).arg(requestedSize.height());
+
+    p->mutex.lock();
+    QImage *cached = p->images.object(key);
+    QImage result = cached? *cached : QImage();
+    p->mutex.unlock();
+
+    if(result.isNull())
+    {
+        QImageReader reader(path);
+        const QSize &original = reader.size();
+        if(requestedSize.isValid() && original.isValid())
+            reader.setScaledSize(original.scaled(requestedSize, Qt::KeepAspectRatio));
+
+        result = reader.read();
+        if(!result.isNull())
+        {
+            QMutexLocker locker(&p->mutex);
+            p->images.insert(key, new QImage(result), result.byteCount());
+        }
+    }
+
+    if(size)
+        *size = result.size();
+
+    return result;
+}
+
+void PoetThumbnailCache::request(int poet)
+{
+    if(!poet || !localPath(poet).isEmpty())
+        return;
+    if(p->failed.contains(poet) && p->failed.value(poet).retryTime > QDateTime::currentMSecsSinceEpoch())
+        return;
+    for(int downloading: p->downloads)
+        if(downloading == poet)
+            return;
+
+    QNetworkRequest request(QUrl(THUMB_WEB_LINK.arg(poet)));
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+    QNetworkReply *reply = p->network->get(request);
+    p->downloads[reply] = poet;
+
+    connect(reply, &QNetworkReply::finished, this, &PoetThumbnailCache::downloadFinished);
+}
+
+void PoetThumbnailCache::downloadFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if(!reply || !p->downloads.contains(reply))
+        return;
+
+    const int poet = p->downloads.take(reply);
+    reply->deleteLater();
+
+    const QByteArray &data = (reply->error() == QNetworkReply::NoError? reply->readAll() : QByteArray());
+    const QString &path = QString(downloadPath() + "/%1.png").arg(poet);
+
+    QSaveFile file(path);
+    if(data.isEmpty() || !file.open(QSaveFile::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        // Not asked again until the backoff passes, it doubles on each failure
+        PoetThumbnailFailure &failure = p->failed[poet];
+        const qint64 delay = qMin<qint64>(qint64(THUMB_RETRY_BASE_DELAY) << qMin(failure.count, 16), THUMB_RETRY_MAX_DELAY);
+        failure.retryTime = QDateTime::currentMSecsSinceEpoch() + delay;
+        failure.count++;
+        return;
+    }
+
+    p->failed.remove(poet);
+
+    p->mutex.lock();
+    p->files[poet] = path;
+    p->mutex.unlock();
+
+    if(p->atlasLoaded)
+        p->atlasTimer->start();
+
+    emit ready(poet);
+}
+
+/*!
+ * Repacks the downloaded thumbnails on the global thread pool. It runs a
+ * few seconds after the last download, so a page of new poets costs one
+ * pass.
+ */
+void PoetThumbnailCache::generateAtlas()
+{
+    if(p->atlasWatcher->isRunning())
+    {
+        p->atlasTimer->start();
+        return;
+    }
+
+    p->atlasWatcher->setFuture(QtConcurrent::run(&PoetThumbnailAtlas::generate, downloadPath(), atlasPath()));
+}
+
+void PoetThumbnailCache::atlasFinished()
+{
+    const PoetThumbnailAtlas &atlas = p->atlasWatcher->result();
+    if(atlas.isNull())
+        return;
+
+    QMutexLocker locker(&p->mutex);
+    p->atlas = atlas;
+    p->images.clear();
+}
+
+PoetThumbnailCache::~PoetThumbnailCache()
+{
+    delete p;
+}
+
+
+PoetThumbnailImageProvider::PoetThumbnailImageProvider() :
+    QQuickImageProvider(QQuickImageProvider::Image, QQmlImageProviderBase::ForceAsynchronousImageLoading)
+{
+}
+
+QImage PoetThumbnailImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    return PoetThumbnailCache::instance()->image(id.toInt(), requestedSize, size);
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POETTHUMBNAILCACHE_H
+#define POETTHUMBNAILCACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QQuickImageProvider>
+
+/*!
+ * Process wide store of the poet thumbnails. It keeps an index of the
+ * downloaded files, an LRU of decoded images and starts at most one
+ * download per poet, whoever asks for it. Downloaded thumbnails are
+ * packed into a PoetThumbnailAtlas in the background.
+ */
+class PoetThumbnailCachePrivate;
+class PoetThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    static PoetThumbnailCache *instance();
+    static QString downloadPath();
+    static QString atlasPath();
+
+    QString localPath(int poet);
+    QImage image(int poet, const QSize &requestedSize, QSize *size = 0);
+
+public slots:
+    void request(int poet);
+
+signals:
+    void ready(int poet);
+
+private slots:
+    void downloadFinished();
+    void generateAtlas();
+    void atlasFinished();
+
+private:
+    PoetThumbnailCache(QObject *parent = 0);
+    ~PoetThumbnailCache();
+
+    void initIndex();
+    void initAtlas();
+
+private:
+    PoetThumbnailCachePrivate *p;
+};
+
+/*!
+ * Serves "image://poets/<id>" urls from the PoetThumbnailCache.
+ */
+class PoetThumbnailImageProvider : public QQuickImageProvider
+{
+public:
+    PoetThumbnailImageProvider();
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+};
+
+#endif // POETTHUMBNAILCACHE_H
@@ -38,17 +38,21 @@ Item {
         visible: false
 
         property string filePath
+        property int dependents
 
         Text {
             id: delete_warn
-            font.pixelSize: 17*globalFontDensity*Devices.fontDensity
+            font.pixelSize: (msg_item.dependents? 11 : 17)*globalFontDensity*Devices.fontDensity
             font.family: AsemanApp.globalFont.family
             anchors.margins: 10*Devices.density
             anchors.left: parent.left
             anchors.right: parent.horizontalCenter
             anchors.verticalCenter: parent.verticalCenter
             horizontalAlignment: Text.AlignHCenter
+            wrapMode: Text.WrapAtWordBoundaryOrAnywhere
             color: "#ffffff"
+            text: msg_item.dependents? qsTr("%1 newer backups are based on this one and will be deleted too.").arg(msg_item.dependents)
+                                     : qsTr("Are you sure?")
         }
 
         Button {
@@ -62,7 +66,7 @@ Item {
             normalColor: "#aaC80000"
             onClicked: {
                 if( msg_item.filePath != "" )
-                    Meikade.removeFile(msg_item.filePath)
+                    Backuper.remove(msg_item.filePath)
 
                 hideRollerDialog()
                 prefrences.refresh()
@@ -135,6 +139,7 @@ Item {
                 normalColor: "#00000000"
                 onClicked: {
                     msg_item.filePath = item.file
+                    msg_item.dependents = Backuper.dependents(item.file).length
                     showRollerDialog( item.mapToItem(main,0,0).y, item.mapToItem(main,0,item.height).y, msg_item )
                 }
 
@@ -261,7 +266,6 @@ Item {
     }
 
     function initTranslations(){
-        delete_warn.text = qsTr("Are you sure?")
         yes_button.text  = qsTr("Delete")
         no_button.text   = qsTr("Cancel")
     }
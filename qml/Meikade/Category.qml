@@ -113,6 +113,8 @@ Item {
             var poems = Database.catPoems(category.catId)
             if(poems.length != 0)
                 model.append({"identifier": -1})
+            if(category.catId != 0)
+                Database.prefetchCategory(category.catId)
 
             focus = true
         }
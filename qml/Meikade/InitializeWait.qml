@@ -62,6 +62,10 @@ Item {
         onExtractProgress: {
             progressbar.percent = percent
         }
+        onMigrationProgress: {
+            progressbar.percent = percent
+        }
+        onMigratingChanged: initTranslations()
     }
 
     Connections{
@@ -70,7 +74,7 @@ Item {
     }
 
     function initTranslations(){
-        init_txt.text = qsTr("Installing Database")
+        init_txt.text = Database.migrating? qsTr("Updating Database") : qsTr("Installing Database")
     }
 
     Component.onCompleted: initTranslations()
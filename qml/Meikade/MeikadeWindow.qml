@@ -126,7 +126,8 @@ MeikadeWindowBase {
         target: Backuper
         onActiveChanged: {
             if( Backuper.active ) {
-                showWaitDialog()
+                var wait = showWaitDialog()
+                wait.progress = Qt.binding(function(){ return Backuper.progress })
                 UserData.disconnect()
                 main.blockBack = true
             } else {
@@ -347,6 +347,27 @@ Item {
                             stickerDialog.poet = poet
                         }
                     }
+                    MenuItem {
+                        text: qsTr("Share Verse Images")
+                        font.family: AsemanApp.globalFont.family
+                        font.pixelSize: 9*Devices.fontDensity
+                        enabled: selectMode
+                        onTriggered: {
+                            var poet
+                            var catId = Database.poemCat(poem_header.poemId)
+                            while( catId ) {
+                                poet = Database.catName(catId)
+                                catId = Database.parentOf(catId)
+                            }
+
+                            networkFeatures.pushAction( ("Share Verse Images: %1").arg(poem_header.poemId) )
+                            var texts = getSelectedTexts()
+                            stickerDialog = sticker_dialog_component.createObject(view)
+                            stickerDialog.text = texts.length? texts[0] : ""
+                            stickerDialog.texts = texts
+                            stickerDialog.poet = poet
+                        }
+                    }
                     MenuItem {
                         text: qsTr("Share")
                         font.family: AsemanApp.globalFont.family
@@ -386,6 +407,17 @@ Item {
         }
     }
 
+    function getSelectedTexts() {
+        var result = new Array
+        var vorders = Database.poemVerses(poem_header.poemId)
+        for( var i=0; i<vorders.length; i++ )
+            if(selectionHash.contains(vorders[i]))
+                result[result.length] = selectionHash.value(vorders[i])
+
+        selectMode = false
+        return result
+    }
+
     function getPoemText(poetName) {
         var poet
         var catId = Database.poemCat(poem_header.poemId)
@@ -57,7 +57,11 @@ Rectangle {
         }
 
         var cat = Database.poemCat(poemId)
-        poemsArray = Database.catPoems(cat)
+        var requestedPoem = poemId
+        Database.catPoemsAsync(cat, function(poems){
+            if(requestedPoem == poemId)
+                poemsArray = poems
+        })
 
         var fileName = cat
         var filePath = "banners/" + fileName + ".jpg"
@@ -471,8 +475,18 @@ Rectangle {
 
             refresh_timer.idx = 0
             refresh_timer.moveToVerse = -1
-            refresh_timer.verses = Database.poemVerses(poemId)
-            refresh_timer.restart()
+            refresh_timer.verses = new Array
+            refresh_timer.loading = true
+            var requestedPoem = poemId
+            Database.poemVersesAsync(poemId, function(verses){
+                if(requestedPoem != poemId)
+                    return
+
+                refresh_timer.loading = false
+                refresh_timer.verses = verses
+                refresh_timer.restart()
+                Database.prefetchPoem(requestedPoem)
+            })
             focus = true
         }
 
@@ -506,6 +520,7 @@ Rectangle {
             property int idx: 0
             property variant verses: new Array
             property int moveToVerse: -1
+            property bool loading: false
         }
 
         function add( poem_id, verse_id, single ) {
@@ -517,7 +532,7 @@ Rectangle {
         }
 
         function goTo( vid, force ){
-            if( refresh_timer.running && !force ) {
+            if( (refresh_timer.running || refresh_timer.loading) && !force ) {
                 refresh_timer.moveToVerse = vid
                 return
             }
@@ -30,6 +30,7 @@ Rectangle {
     property alias poet: poet_txt.text
 
     property real xratio: 2
+    property variant texts: []
 
     FontLoader{
         source: Meikade.resourcePath + "/fonts/BYekan.ttf"
@@ -55,13 +56,25 @@ Rectangle {
         }
     }
 
-    StickerWriter {
+    StickerRenderer {
         id: writer
-        item: frame
-        onSaved: {
-            indicator_disabler.restart()
-            lastDest = dest
-        }
+        text: txt.text
+        poet: poet_txt.visible? poet_txt.text : ""
+        ratio: frame.ratio
+        backgroundColor: frame.color
+        foregroundColor: images_frame.color
+        fontFamily: txt.font.family
+        fontSize: txt.fontSize
+        fontScale: globalFontDensity*Devices.fontDensity/Devices.density
+        stickerImage: frame.imagePath
+        stickerType: frame.imageType
+        logoImage: meikade_logo.visible? meikade_logo.source : ""
+        backgroundImage: frame_image.source
+        // Stickers are opaque and get shared: a jpeg under 512KB instead of a multi megabyte png
+        format: availableFormats.indexOf("jpeg") != -1? "jpeg" : "png"
+        targetSize: 512*1024
+        onSaved: lastDest = dest
+        onFinished: indicator_disabler.restart()
 
         property string lastDest
     }
@@ -100,7 +113,10 @@ Rectangle {
                     indicator.active = true
                     progress_rect.visible = true
                     networkFeatures.pushAction( ("Image saved with image %1").arg(frame_image.source==""?"off":"on") )
-                    writer.save(Devices.picturesLocation + "/Meikade", Qt.size(1280, 1280/frame.ratio))
+                    if(texts.length > 1)
+                        writer.saveBatch(Devices.picturesLocation + "/Meikade", texts, 1280)
+                    else
+                        writer.save(Devices.picturesLocation + "/Meikade", [1280])
                 }
             }
         }
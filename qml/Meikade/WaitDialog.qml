@@ -24,6 +24,7 @@ Item {
     anchors.fill: parent
 
     property alias text: txt.text
+    property real progress: -1
 
     Text {
         id: txt
@@ -42,6 +43,18 @@ Item {
         anchors.topMargin: 10*Devices.density
     }
 
+    ProgressBar {
+        anchors.left: parent.left
+        anchors.right: parent.right
+        anchors.top: cradle.bottom
+        anchors.topMargin: 10*Devices.density
+        anchors.margins: 20*Devices.density
+        visible: wait_dialog.progress >= 0
+        percent: 100*wait_dialog.progress
+        color: "#000000"
+        topColor: "#0d80ec"
+    }
+
     Connections{
         target: Meikade
         onCurrentLanguageChanged: initTranslations()
@@ -16,6 +16,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define RESOURCE_CHUNK_SIZE (1024*1024)
+#define RESOURCE_CHUNKED_MARKER -2
+#define RESOURCE_COMPRESSION 6
+
 #include "resourcemanager.h"
 #include "SimpleQtCryptor/simpleqtcryptor.h"
 
@@ -23,6 +27,10 @@
 #include <QDataStream>
 #include <QFileInfo>
 #include <QUuid>
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QDebug>
 
 class ResourceManagerPrivate
@@ -30,8 +38,35 @@ class ResourceManagerPrivate
 public:
     QFile file;
     QDataStream stream;
+    std::function<void(qint64,qint64)> progress;
 };
 
+/*!
+ * Chunks are compressed and encrypted on their own, with a fresh
+ * encryptor and IV each, so they can run in parallel. qrand() is per
+ * thread, so every job seeds it to keep the pool threads from producing
+ * the same IVs.
+ */
+static QByteArray resourceEncryptChunk(QSharedPointer<SimpleQtCryptor::Key> key, const QByteArray &plain, uint seed)
+{
+    qsrand(seed);
+
+    QByteArray result;
+    SimpleQtCryptor::Encryptor enc( key, SimpleQtCryptor::SERPENT_32, SimpleQtCryptor::ModeCFB, SimpleQtCryptor::NoChecksum );
+    enc.encrypt( qCompress(plain, RESOURCE_COMPRESSION), result, true );
+    return result;
+}
+
+static QByteArray resourceDecryptChunk(QSharedPointer<SimpleQtCryptor::Key> key, const QByteArray &cipher)
+{
+    QByteArray compressed;
+    SimpleQtCryptor::Decryptor dec( key, SimpleQtCryptor::SERPENT_32, SimpleQtCryptor::ModeCFB );
+    if( dec.decrypt(cipher, compressed, true) != SimpleQtCryptor::NoError )
+        return QByteArray();
+
+    return qUncompress(compressed);
+}
+
 ResourceManager::ResourceManager(const QString &path, bool writeMode)
 {
     p = new ResourceManagerPrivate;
@@ -41,6 +76,16 @@ ResourceManager::ResourceManager(const QString &path, bool writeMode)
     p->stream.setVersion( QDataStream::Qt_5_0 );
 }
 
+void ResourceManager::setProgressCallback(const std::function<void (qint64, qint64)> &callback)
+{
+    p->progress = callback;
+}
+
+/*!
+ * Writes the file as independent chunks. Reading, the compress and
+ * encrypt jobs and writing overlap; at most two chunks per thread are
+ * in flight, and they are written in order.
+ */
 void ResourceManager::addFile(const QString &filePath, const QString & password)
 {
     QFile src( filePath );
@@ -49,21 +94,42 @@ void ResourceManager::addFile(const QString &filePath, const QString & password)
         return;
 
     QSharedPointer<SimpleQtCryptor::Key> gKey = QSharedPointer<SimpleQtCryptor::Key>(new SimpleQtCryptor::Key(password));
-    SimpleQtCryptor::Encryptor enc( gKey, SimpleQtCryptor::SERPENT_32, SimpleQtCryptor::ModeCFB, SimpleQtCryptor::NoChecksum );
+    gKey->expandKeySerpent();
 
-    p->stream << src.size();
-    p->stream << src_info.fileName();
+    const qint64 size = src.size();
+    const quint32 chunks = static_cast<quint32>((size + RESOURCE_CHUNK_SIZE - 1)/RESOURCE_CHUNK_SIZE);
 
-    QByteArray ar;
-    QByteArray tmp;
+    p->stream << qint64(RESOURCE_CHUNKED_MARKER);
+    p->stream << size;
+    p->stream << src_info.fileName();
+    p->stream << chunks;
+
+    QThreadPool pool;
+    const int maxInFlight = 2*qMax(1, QThread::idealThreadCount());
+    const uint nonce = qHash(QUuid::createUuid());
+
+    QQueue< QFuture<QByteArray> > queue;
+    QQueue<qint64> lengths;
+    qint64 done = 0;
+    auto writeFront = [&](){
+        p->stream << queue.dequeue().result();
+        done += lengths.dequeue();
+        if( p->progress )
+            p->progress(done, size);
+    };
+
+    for( quint32 i=0; i<chunks; i++ )
+    {
+        const QByteArray &plain = src.read(RESOURCE_CHUNK_SIZE);
+        lengths.enqueue(plain.size());
+        queue.enqueue(QtConcurrent::run(&pool, resourceEncryptChunk, gKey, plain, nonce ^ (i*2654435761u)));
 
-    do {
-        tmp = src.read(1024*1024);
-        enc.encrypt( tmp, ar, tmp.isEmpty() ) ;
+        while( queue.count() >= maxInFlight )
+            writeFront();
+    }
 
-        p->stream << ar;
-        ar.clear();
-    } while( !tmp.isEmpty() );
+    while( !queue.isEmpty() )
+        writeFront();
 }
 
 QString ResourceManager::extractFile(const QString &filePath, const QString & password)
@@ -77,6 +143,11 @@ QString ResourceManager::extractFile(const QString &filePath, const QString & pa
 
     qint64 size;
     p->stream >> size;
+    if( size == RESOURCE_CHUNKED_MARKER )
+    {
+        dest.close();
+        return extractChunks(filePath, gKey);
+    }
     if( !size )
     {
         dest.close();
@@ -108,6 +179,60 @@ QString ResourceManager::extractFile(const QString &filePath, const QString & pa
     return fileName;
 }
 
+QString ResourceManager::extractChunks(const QString &filePath, QSharedPointer<SimpleQtCryptor::Key> key)
+{
+    QFile dest( filePath );
+    if( !dest.open(QFile::WriteOnly) )
+        return QString();
+
+    key->expandKeySerpent();
+
+    qint64 size;
+    QString fileName;
+    quint32 chunks;
+    p->stream >> size;
+    p->stream >> fileName;
+    p->stream >> chunks;
+
+    QThreadPool pool;
+    const int maxInFlight = 2*qMax(1, QThread::idealThreadCount());
+
+    QQueue< QFuture<QByteArray> > queue;
+    qint64 done = 0;
+    bool ok = true;
+    auto writeFront = [&](){
+        const QByteArray &plain = queue.dequeue().result();
+        if( plain.isEmpty() || dest.write(plain) != plain.size() )
+            ok = false;
+
+        done += plain.size();
+        if( p->progress )
+            p->progress(done, size);
+    };
+
+    for( quint32 i=0; i<chunks && ok && p->stream.status() == QDataStream::Ok; i++ )
+    {
+        QByteArray cipher;
+        p->stream >> cipher;
+        queue.enqueue(QtConcurrent::run(&pool, resourceDecryptChunk, key, cipher));
+
+        while( queue.count() >= maxInFlight )
+            writeFront();
+    }
+
+    while( !queue.isEmpty() )
+        writeFront();
+
+    dest.close();
+    if( !ok || done != size )
+    {
+        QFile::remove(filePath);
+        return QString();
+    }
+
+    return fileName;
+}
+
 void ResourceManager::writeHead(const QString &password)
 {
     p->file.reset();
@@ -20,6 +20,12 @@
 #define RESOURCEMANAGER_H
 
 #include <QString>
+#include <QSharedPointer>
+#include <functional>
+
+namespace SimpleQtCryptor {
+class Key;
+}
 
 class ResourceManagerPrivate;
 class ResourceManager
@@ -28,6 +34,8 @@ public:
     ResourceManager(const QString & path, bool writeMode = false );
     ~ResourceManager();
 
+    void setProgressCallback(const std::function<void(qint64 done, qint64 total)> &callback);
+
     void addFile(const QString & filePath , const QString &password = QString());
     QString extractFile(const QString & filePath , const QString &password = QString());
 
@@ -39,6 +47,9 @@ public:
     qint64 size();
     qint64 currentPosition();
 
+private:
+    QString extractChunks(const QString & filePath, QSharedPointer<SimpleQtCryptor::Key> key);
+
 private:
     ResourceManagerPrivate *p;
 };
@@ -0,0 +1,848 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define STICKER_UNIT_WIDTH 320.0
+#define STICKER_LINE_HEIGHT 1.3
+#define STICKER_LINEAR_STEPS 4096
+#define STICKER_DEFAULT_QUALITY 90
+#define STICKER_MIN_QUALITY 30
+#define STICKER_TARGET_PASSES 3
+#define STICKER_MIN_DIMENSION 64
+#define STICKER_PNG_COMPRESSION 50
+
+#include "stickerrenderer.h"
+#include "stickermodel.h"
+
+#include <QPainter>
+#include <QTextLayout>
+#include <QFontMetricsF>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QDir>
+#include <QUuid>
+#include <qmath.h>
+
+class StickerRendererPrivate
+{
+public:
+    StickerRenderOptions options;
+    StickerOutputOptions output;
+    QThreadPool *pool;
+    QStringList files;
+    int pending;
+    int done;
+    int total;
+};
+
+StickerRenderer::StickerRenderer(QObject *parent) :
+    QObject(parent)
+{
+    p = new StickerRendererPrivate;
+    p->pending = 0;
+    p->done = 0;
+    p->total = 0;
+    p->options.backgroundColor = QColor("#ebc220");
+    p->options.foregroundColor = QColor("#1b1b1b");
+
+    p->pool = new QThreadPool(this);
+}
+
+void StickerRenderer::setText(const QString &text)
+{
+    if(p->options.text == text)
+        return;
+
+    p->options.text = text;
+    emit textChanged();
+}
+
+QString StickerRenderer::text() const
+{
+    return p->options.text;
+}
+
+void StickerRenderer::setPoet(const QString &poet)
+{
+    if(p->options.poet == poet)
+        return;
+
+    p->options.poet = poet;
+    emit poetChanged();
+}
+
+QString StickerRenderer::poet() const
+{
+    return p->options.poet;
+}
+
+void StickerRenderer::setRatio(qreal ratio)
+{
+    if(p->options.ratio == ratio)
+        return;
+
+    p->options.ratio = ratio;
+    emit ratioChanged();
+}
+
+qreal StickerRenderer::ratio() const
+{
+    return p->options.ratio;
+}
+
+void StickerRenderer::setBackgroundColor(const QColor &color)
+{
+    if(p->options.backgroundColor == color)
+        return;
+
+    p->options.backgroundColor = color;
+    emit backgroundColorChanged();
+}
+
+QColor StickerRenderer::backgroundColor() const
+{
+    return p->options.backgroundColor;
+}
+
+void StickerRenderer::setForegroundColor(const QColor &color)
+{
+    if(p->options.foregroundColor == color)
+        return;
+
+    p->options.foregroundColor = color;
+    emit foregroundColorChanged();
+}
+
+QColor StickerRenderer::foregroundColor() const
+{
+    return p->options.foregroundColor;
+}
+
+void StickerRenderer::setFontFamily(const QString &family)
+{
+    if(p->options.fontFamily == family)
+        return;
+
+    p->options.fontFamily = family;
+    emit fontFamilyChanged();
+}
+
+QString StickerRenderer::fontFamily() const
+{
+    return p->options.fontFamily;
+}
+
+void StickerRenderer::setFontSize(int size)
+{
+    if(p->options.fontSize == size)
+        return;
+
+    p->options.fontSize = size;
+    emit fontSizeChanged();
+}
+
+int StickerRenderer::fontSize() const
+{
+    return p->options.fontSize;
+}
+
+/*!
+ * The factor the preview applies to fontSize besides the frame width
+ * (the font and screen densities), so the export wraps like the preview.
+ */
+void StickerRenderer::setFontScale(qreal scale)
+{
+    if(p->options.fontScale == scale)
+        return;
+
+    p->options.fontScale = scale;
+    emit fontScaleChanged();
+}
+
+qreal StickerRenderer::fontScale() const
+{
+    return p->options.fontScale;
+}
+
+void StickerRenderer::setStickerImage(const QUrl &url)
+{
+    if(p->options.stickerImage == url)
+        return;
+
+    p->options.stickerImage = url;
+    emit stickerImageChanged();
+}
+
+QUrl StickerRenderer::stickerImage() const
+{
+    return p->options.stickerImage;
+}
+
+void StickerRenderer::setStickerType(int type)
+{
+    if(p->options.stickerType == type)
+        return;
+
+    p->options.stickerType = type;
+    emit stickerTypeChanged();
+}
+
+int StickerRenderer::stickerType() const
+{
+    return p->options.stickerType;
+}
+
+void StickerRenderer::setLogoImage(const QUrl &url)
+{
+    if(p->options.logoImage == url)
+        return;
+
+    p->options.logoImage = url;
+    emit logoImageChanged();
+}
+
+QUrl StickerRenderer::logoImage() const
+{
+    return p->options.logoImage;
+}
+
+void StickerRenderer::setBackgroundImage(const QUrl &url)
+{
+    if(p->options.backgroundImage == url)
+        return;
+
+    p->options.backgroundImage = url;
+    emit backgroundImageChanged();
+}
+
+QUrl StickerRenderer::backgroundImage() const
+{
+    return p->options.backgroundImage;
+}
+
+void StickerRenderer::setFormat(const QString &format)
+{
+    if(p->output.format == format)
+        return;
+
+    p->output.format = format;
+    emit formatChanged();
+}
+
+QString StickerRenderer::format() const
+{
+    return p->output.format;
+}
+
+void StickerRenderer::setQuality(int quality)
+{
+    if(p->output.quality == quality)
+        return;
+
+    p->output.quality = quality;
+    emit qualityChanged();
+}
+
+int StickerRenderer::quality() const
+{
+    return p->output.quality;
+}
+
+void StickerRenderer::setTargetSize(int bytes)
+{
+    if(p->output.targetSize == bytes)
+        return;
+
+    p->output.targetSize = bytes;
+    emit targetSizeChanged();
+}
+
+int StickerRenderer::targetSize() const
+{
+    return p->output.targetSize;
+}
+
+QStringList StickerRenderer::availableFormats()
+{
+    QStringList result;
+    const QList<QByteArray> &supported = QImageWriter::supportedImageFormats();
+    for(const char *format: {"png", "jpeg", "webp"})
+        if(supported.contains(format))
+            result << format;
+
+    return result;
+}
+
+bool StickerRenderer::rendering() const
+{
+    return p->pending != 0;
+}
+
+static QString stickerLocalPath(const QUrl &url)
+{
+    if(url.isEmpty())
+        return QString();
+    if(url.scheme() == "qrc")
+        return ":" + url.path();
+    if(url.isLocalFile())
+        return url.toLocalFile();
+    return url.toString();
+}
+
+static QImage stickerImage(const QUrl &url, qreal width = 0)
+{
+    const QString &path = stickerLocalPath(url);
+    if(path.isEmpty())
+        return QImage();
+
+    QImageReader reader(path);
+    const QSize &size = reader.size();
+    if(width > 0 && size.isValid() && size.width() > width)
+        reader.setScaledSize(QSize(qRound(width), qRound(size.height()*width/size.width())));
+
+    return reader.read();
+}
+
+static qreal stickerSquare(const QSize &size)
+{
+    const qreal width = size.width();
+    const qreal height = size.height();
+    return (width>height? height - height/3 : width - width/2);
+}
+
+static qreal layoutStickerText(QTextLayout &layout, qreal width)
+{
+    QTextOption option(Qt::AlignHCenter);
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout.setTextOption(option);
+
+    qreal height = 0;
+    layout.beginLayout();
+    forever
+    {
+        QTextLine line = layout.createLine();
+        if(!line.isValid())
+            break;
+
+        line.setLineWidth(width);
+        line.setPosition(QPointF(0, height));
+        height += line.height()*STICKER_LINE_HEIGHT;
+    }
+    layout.endLayout();
+    return height;
+}
+
+/*!
+ * Decoded images a batch shares: the background composed at the output
+ * size and the sticker art and logo scaled for it. Whichever job comes
+ * first builds them, the others wait and reuse.
+ */
+class StickerRenderResources
+{
+public:
+    StickerRenderResources() : ready(false) {}
+
+    void prepare(const StickerRenderOptions &options, const QSize &size);
+
+    QMutex mutex;
+    bool ready;
+    QImage background;
+    QImage sticker;
+    QImage mirroredSticker;
+    QImage logo;
+};
+
+void StickerRenderResources::prepare(const StickerRenderOptions &options, const QSize &size)
+{
+    QMutexLocker locker(&mutex);
+    if(ready)
+        return;
+
+    const qreal width = size.width();
+    const qreal height = size.height();
+    const qreal square = stickerSquare(size);
+
+    background = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    background.fill(options.backgroundColor);
+
+    const QImage &image = stickerImage(options.backgroundImage);
+    if(!image.isNull())
+    {
+        QPainter painter(&background);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        const QSizeF &scaled = QSizeF(image.size()).scaled(size, Qt::KeepAspectRatioByExpanding);
+        painter.drawImage(QRectF(QPointF((width-scaled.width())/2, (height-scaled.height())/2), scaled), image);
+    }
+
+    const qreal stickerWidth = (options.stickerType == StickerModel::StickerDouble? square*0.8 : square*0.4);
+    sticker = stickerImage(options.stickerImage, stickerWidth);
+    mirroredSticker = sticker.mirrored(false, true);
+    logo = stickerImage(options.logoImage, square*0.25);
+    ready = true;
+}
+
+/*!
+ * Renders one sticker of the given size. Sizes follow StickerDialog.qml,
+ * measured in units of the centered square frame, so every output size
+ * keeps the composition of the preview.
+ */
+QImage StickerRenderer::render(const StickerRenderOptions &options, const QSize &size)
+{
+    StickerRenderResources resources;
+    return render(options, size, &resources);
+}
+
+QImage StickerRenderer::render(const StickerRenderOptions &options, const QSize &size, StickerRenderResources *resources)
+{
+    resources->prepare(options, size);
+
+    const qreal width = size.width();
+    const qreal height = size.height();
+    const qreal square = stickerSquare(size);
+    const qreal unit = square/STICKER_UNIT_WIDTH;
+
+    QImage result = resources->background.copy();
+    QPainter painter(&result);
+    painter.setRenderHints(QPainter::Antialiasing|QPainter::SmoothPixmapTransform|QPainter::TextAntialiasing);
+
+    // Everything but the background is painted with the foreground color through its alpha
+    QImage mask(size, QImage::Format_ARGB32_Premultiplied);
+    mask.fill(Qt::transparent);
+
+    QPainter maskPainter(&mask);
+    maskPainter.setRenderHints(painter.renderHints());
+    maskPainter.setPen(Qt::black);
+
+    QFont font(options.fontFamily);
+    font.setPixelSize(qMax(1, qRound(options.fontSize*options.fontScale*unit)));
+
+    // QTextLayout doesn't break at '\n', QQuickText converts it the same way
+    QTextLayout layout(QString(options.text).replace(QLatin1Char('\n'), QChar::LineSeparator), font);
+    const qreal textHeight = layoutStickerText(layout, width);
+
+    const QImage &sticker = resources->sticker;
+    switch(options.stickerType)
+    {
+    case StickerModel::StickerDouble:
+    {
+        const qreal stickerHeight = (sticker.isNull()? 0 : sticker.height()*square*0.8/sticker.width());
+        const qreal spacing = 40*unit;
+        const qreal top = (height - textHeight - 2*(stickerHeight+spacing))/2;
+        const QRectF topRect((width-square*0.8)/2, top, square*0.8, stickerHeight);
+        const QRectF bottomRect(topRect.x(), top + stickerHeight + textHeight + 2*spacing, square*0.8, stickerHeight);
+
+        if(!sticker.isNull())
+        {
+            maskPainter.drawImage(topRect, sticker);
+            maskPainter.drawImage(bottomRect, resources->mirroredSticker);
+        }
+        layout.draw(&maskPainter, QPointF(0, top + stickerHeight + spacing));
+    }
+        break;
+
+    case StickerModel::StickerTopRight:
+    case StickerModel::StickerBottomLeft:
+    {
+        if(!sticker.isNull())
+        {
+            const qreal stickerHeight = sticker.height()*square*0.4/sticker.width();
+            const qreal margin = square*0.1;
+            const QPointF &pos = (options.stickerType == StickerModel::StickerTopRight?
+                                      QPointF(width - margin - square*0.4, margin) :
+                                      QPointF(margin, height - margin - stickerHeight));
+            maskPainter.drawImage(QRectF(pos, QSizeF(square*0.4, stickerHeight)), sticker);
+        }
+        layout.draw(&maskPainter, QPointF(0, (height-textHeight)/2));
+    }
+        break;
+    }
+
+    const QImage &logo = resources->logo;
+    const QSizeF logoSize(square*0.25, square*0.125);
+
+    QFont poetFont(options.fontFamily);
+    poetFont.setPixelSize(qMax(1, qRound(logoSize.height()/2)));
+    const QFontMetricsF poetMetrics(poetFont);
+    const QSizeF poetSize(options.poet.isEmpty()? 0 : poetMetrics.width(options.poet), options.poet.isEmpty()? 0 : poetMetrics.height());
+
+    const qreal spacing = (logo.isNull() || options.poet.isEmpty()? 0 : 15*unit);
+    const qreal columnWidth = qMax(logo.isNull()? 0 : logoSize.width(), poetSize.width());
+    const qreal columnHeight = (logo.isNull()? 0 : logoSize.height()) + poetSize.height() + spacing;
+    const qreal margin = 20*unit;
+    const bool bottomLeft = (options.stickerType == StickerModel::StickerBottomLeft);
+    const QPointF column(bottomLeft? width - columnWidth - margin : margin,
+                         bottomLeft? margin : height - columnHeight - margin);
+
+    if(!options.poet.isEmpty())
+    {
+        maskPainter.setFont(poetFont);
+        maskPainter.drawText(QRectF(column, QSizeF(columnWidth, poetSize.height())), Qt::AlignCenter, options.poet);
+    }
+    if(!logo.isNull())
+        maskPainter.drawImage(QRectF(QPointF(column.x() + (columnWidth-logoSize.width())/2, column.y() + poetSize.height() + spacing), logoSize), logo);
+
+    maskPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    maskPainter.fillRect(mask.rect(), options.foregroundColor);
+    maskPainter.end();
+
+    painter.drawImage(0, 0, mask);
+    painter.end();
+    return result;
+}
+
+class StickerLinearTables
+{
+public:
+    StickerLinearTables()
+    {
+        for(int i=0; i<256; i++)
+        {
+            const double c = i/255.0;
+            toLinear[i] = (c <= 0.04045? c/12.92 : qPow((c+0.055)/1.055, 2.4));
+        }
+        for(int i=0; i<STICKER_LINEAR_STEPS; i++)
+        {
+            const double l = double(i)/(STICKER_LINEAR_STEPS-1);
+            const double c = (l <= 0.0031308? l*12.92 : 1.055*qPow(l, 1/2.4) - 0.055);
+            toSrgb[i] = static_cast<uchar>(qBound(0, qRound(c*255), 255));
+        }
+    }
+
+    float toLinear[256];
+    uchar toSrgb[STICKER_LINEAR_STEPS];
+};
+
+class StickerSpan
+{
+public:
+    int index;
+    float weight;
+};
+
+static QVector< QVector<StickerSpan> > stickerSpans(int source, int destination)
+{
+    QVector< QVector<StickerSpan> > result(destination);
+    const double scale = double(source)/destination;
+    for(int i=0; i<destination; i++)
+    {
+        const double from = i*scale;
+        const double to = (i+1)*scale;
+        for(int s=int(from); s<to && s<source; s++)
+        {
+            const double weight = qMin<double>(to, s+1) - qMax<double>(from, s);
+            if(weight <= 0)
+                continue;
+
+            StickerSpan span;
+            span.index = s;
+            span.weight = weight/scale;
+            result[i] << span;
+        }
+    }
+
+    return result;
+}
+
+/*!
+ * Area averaging downscale done on linear light values, so thin bright
+ * strokes of the verse text don't get darker than the preview when a
+ * smaller size is derived from the big render.
+ */
+QImage StickerRenderer::downscale(const QImage &image, const QSize &size)
+{
+    if(size.width() >= image.width() || size.height() >= image.height() || size.isEmpty())
+        return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    static const StickerLinearTables tables;
+    const QImage &source = image.convertToFormat(QImage::Format_ARGB32);
+    const QVector< QVector<StickerSpan> > &xSpans = stickerSpans(source.width(), size.width());
+    const QVector< QVector<StickerSpan> > &ySpans = stickerSpans(source.height(), size.height());
+
+    // Horizontal pass into premultiplied linear floats
+    QVector<float> rows(source.height() * size.width() * 4);
+    for(int y=0; y<source.height(); y++)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        float *out = rows.data() + y*size.width()*4;
+        for(int x=0; x<size.width(); x++, out += 4)
+        {
+            float r = 0, g = 0, b = 0, a = 0;
+            for(const StickerSpan &span: xSpans.at(x))
+            {
+                const QRgb pixel = line[span.index];
+                const float alpha = qAlpha(pixel)/255.0f * span.weight;
+                r += tables.toLinear[qRed(pixel)] * alpha;
+                g += tables.toLinear[qGreen(pixel)] * alpha;
+                b += tables.toLinear[qBlue(pixel)] * alpha;
+                a += alpha;
+            }
+
+            out[0] = r; out[1] = g; out[2] = b; out[3] = a;
+        }
+    }
+
+    QImage result(size, QImage::Format_ARGB32);
+    for(int y=0; y<size.height(); y++)
+    {
+        QRgb *line = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for(int x=0; x<size.width(); x++)
+        {
+            float r = 0, g = 0, b = 0, a = 0;
+            for(const StickerSpan &span: ySpans.at(y))
+            {
+                const float *in = rows.constData() + (span.index*size.width() + x)*4;
+                r += in[0] * span.weight;
+                g += in[1] * span.weight;
+                b += in[2] * span.weight;
+                a += in[3] * span.weight;
+            }
+
+            if(a <= 0)
+            {
+                line[x] = 0;
+                continue;
+            }
+
+            const int steps = STICKER_LINEAR_STEPS-1;
+            line[x] = qRgba(tables.toSrgb[qBound(0, int(r/a*steps + 0.5f), steps)],
+                            tables.toSrgb[qBound(0, int(g/a*steps + 0.5f), steps)],
+                            tables.toSrgb[qBound(0, int(b/a*steps + 0.5f), steps)],
+                            qBound(0, int(a*255 + 0.5f), 255));
+        }
+    }
+
+    return result.convertToFormat(image.format());
+}
+
+static QByteArray stickerEncode(const QImage &image, const QByteArray &format, int quality)
+{
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QBuffer::WriteOnly);
+
+    QImageWriter writer(&buffer, format);
+    writer.setQuality(quality);
+    if(format == "png")
+        writer.setCompression(STICKER_PNG_COMPRESSION);
+    if(!writer.write(format == "png"? image : image.convertToFormat(QImage::Format_RGB32)))
+        return QByteArray();
+
+    return result;
+}
+
+/*!
+ * Encodes the image with the output options. With a target size, lossy
+ * formats binary search the highest quality that fits; when even
+ * STICKER_MIN_QUALITY (or a png) is too big the image is downscaled and
+ * tried again, a few times at most and never below STICKER_MIN_DIMENSION.
+ * Returns an empty array when the target size can't be met.
+ */
+QByteArray StickerRenderer::encode(const QImage &image, const StickerOutputOptions &output)
+{
+    const QByteArray &format = output.format.toLower().toLatin1();
+    const bool lossy = (format != "png");
+    const int quality = (output.quality < 0? STICKER_DEFAULT_QUALITY : output.quality);
+
+    QImage current = image;
+    QByteArray result;
+    for(int pass=0; pass<=STICKER_TARGET_PASSES; pass++)
+    {
+        result = stickerEncode(current, format, quality);
+        if(result.isEmpty() || output.targetSize <= 0 || result.size() <= output.targetSize)
+            return result;
+
+        if(lossy)
+        {
+            int low = STICKER_MIN_QUALITY;
+            int high = quality-1;
+            QByteArray best;
+            while(low <= high)
+            {
+                const int middle = (low+high)/2;
+                const QByteArray &data = stickerEncode(current, format, middle);
+                if(!data.isEmpty() && data.size() <= output.targetSize)
+                {
+                    best = data;
+                    low = middle+1;
+                }
+                else
+                    high = middle-1;
+            }
+
+            if(!best.isEmpty())
+                return best;
+        }
+
+        const int shortest = qMin(current.width(), current.height());
+        if(shortest <= STICKER_MIN_DIMENSION)
+            break;
+
+        qreal factor = qSqrt(qreal(output.targetSize)/result.size()) * 0.95;
+        factor = qMax(factor, qreal(STICKER_MIN_DIMENSION)/shortest);
+        current = downscale(current, current.size()*factor);
+    }
+
+    return QByteArray();
+}
+
+QStringList StickerRenderer::write(const StickerRenderOptions &options, const QList<QSize> &sizes, const QString &dest,
+                                   const StickerOutputOptions &output, QSharedPointer<StickerRenderResources> resources)
+{
+    QStringList result;
+    if(sizes.isEmpty())
+        return result;
+
+    if(!resources)
+        resources = QSharedPointer<StickerRenderResources>::create();
+
+    QSize largest = sizes.first();
+    for(const QSize &size: sizes)
+        if(size.width() > largest.width())
+            largest = size;
+
+    const QImage &image = render(options, largest, resources.data());
+    const QString &suffix = (output.format.toLower() == "jpeg"? QString("jpg") : output.format.toLower());
+
+    for(const QSize &size: sizes)
+    {
+        const QByteArray &data = encode(size == largest? image : downscale(image, size), output);
+        if(data.isEmpty())
+            continue;
+
+        const QString &path = dest + "/" + QUuid::createUuid().toString().remove("{").remove("}") + "." + suffix;
+        QSaveFile file(path);
+        if(!file.open(QSaveFile::WriteOnly) || file.write(data) != data.size() || !file.commit())
+            continue;
+
+        result << path;
+    }
+
+    return result;
+}
+
+void StickerRenderer::save(const QString &dest, const QVariantList &widths)
+{
+    if(widths.isEmpty() || p->options.ratio <= 0)
+    {
+        emit failed();
+        return;
+    }
+
+    QDir().mkpath(dest);
+    const bool wasRendering = begin(widths.count());
+
+    // Rendered once at the biggest size, the others are derived from it
+    QList<QSize> sizes;
+    for(const QVariant &var: widths)
+    {
+        const int width = var.toInt();
+        sizes << QSize(width, qRound(width/p->options.ratio));
+    }
+
+    startJob(p->options, sizes, dest, QSharedPointer<StickerRenderResources>());
+
+    if(!wasRendering)
+        emit renderingChanged();
+}
+
+/*!
+ * Renders one sticker per text with the current settings. All of them
+ * share the decoded background and sticker art, and the pool threads
+ * keep their glyph caches from one verse to the next.
+ */
+void StickerRenderer::saveBatch(const QString &dest, const QStringList &texts, int width)
+{
+    if(texts.isEmpty() || width <= 0 || p->options.ratio <= 0)
+    {
+        emit failed();
+        return;
+    }
+
+    QDir().mkpath(dest);
+    const bool wasRendering = begin(texts.count());
+
+    const QSize size(width, qRound(width/p->options.ratio));
+    QSharedPointer<StickerRenderResources> resources = QSharedPointer<StickerRenderResources>::create();
+    for(const QString &text: texts)
+    {
+        StickerRenderOptions options = p->options;
+        options.text = text;
+        startJob(options, QList<QSize>() << size, dest, resources);
+    }
+
+    if(!wasRendering)
+        emit renderingChanged();
+}
+
+bool StickerRenderer::begin(int count)
+{
+    const bool wasRendering = rendering();
+    if(!wasRendering)
+    {
+        p->files.clear();
+        p->done = 0;
+        p->total = 0;
+    }
+
+    p->total += count;
+    emit progress(p->done, p->total);
+    return wasRendering;
+}
+
+void StickerRenderer::startJob(const StickerRenderOptions &options, const QList<QSize> &sizes, const QString &dest,
+                               QSharedPointer<StickerRenderResources> resources)
+{
+    const int count = sizes.count();
+    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, count](){
+        const QStringList &files = watcher->result();
+        watcher->deleteLater();
+        p->pending--;
+        p->done += count;
+
+        if(files.count() < count)
+            emit failed();
+        for(const QString &file: files)
+        {
+            p->files << file;
+            emit saved(file);
+        }
+
+        emit progress(p->done, p->total);
+        if(p->pending == 0)
+        {
+            emit finished(p->files);
+            emit renderingChanged();
+        }
+    });
+
+    p->pending++;
+    watcher->setFuture(QtConcurrent::run(p->pool, &StickerRenderer::write, options, sizes, dest, p->output, resources));
+}
+
+StickerRenderer::~StickerRenderer()
+{
+    p->pool->waitForDone();
+    delete p;
+}
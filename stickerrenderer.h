@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STICKERRENDERER_H
+#define STICKERRENDERER_H
+
+#include <QObject>
+#include <QColor>
+#include <QImage>
+#include <QUrl>
+#include <QVariant>
+#include <QStringList>
+#include <QSharedPointer>
+
+class StickerRenderOptions
+{
+public:
+    StickerRenderOptions() :
+        ratio(1),
+        fontSize(25),
+        fontScale(1),
+        stickerType(0)
+    {}
+
+    QString text;
+    QString poet;
+    qreal ratio;
+    QColor backgroundColor;
+    QColor foregroundColor;
+    QString fontFamily;
+    int fontSize;
+    qreal fontScale;
+    QUrl stickerImage;
+    int stickerType;
+    QUrl logoImage;
+    QUrl backgroundImage;
+};
+
+class StickerRenderResources;
+
+class StickerOutputOptions
+{
+public:
+    StickerOutputOptions() :
+        format("png"),
+        quality(-1),
+        targetSize(0)
+    {}
+
+    QString format;
+    int quality;
+    int targetSize;
+};
+
+/*!
+ * Draws the stickers of the share dialog with QPainter, the same layout
+ * StickerDialog.qml shows, and encodes them on a private thread pool.
+ */
+class StickerRendererPrivate;
+class StickerRenderer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
+    Q_PROPERTY(QString poet READ poet WRITE setPoet NOTIFY poetChanged)
+    Q_PROPERTY(qreal ratio READ ratio WRITE setRatio NOTIFY ratioChanged)
+    Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor NOTIFY backgroundColorChanged)
+    Q_PROPERTY(QColor foregroundColor READ foregroundColor WRITE setForegroundColor NOTIFY foregroundColorChanged)
+    Q_PROPERTY(QString fontFamily READ fontFamily WRITE setFontFamily NOTIFY fontFamilyChanged)
+    Q_PROPERTY(int fontSize READ fontSize WRITE setFontSize NOTIFY fontSizeChanged)
+    Q_PROPERTY(qreal fontScale READ fontScale WRITE setFontScale NOTIFY fontScaleChanged)
+    Q_PROPERTY(QUrl stickerImage READ stickerImage WRITE setStickerImage NOTIFY stickerImageChanged)
+    Q_PROPERTY(int stickerType READ stickerType WRITE setStickerType NOTIFY stickerTypeChanged)
+    Q_PROPERTY(QUrl logoImage READ logoImage WRITE setLogoImage NOTIFY logoImageChanged)
+    Q_PROPERTY(QUrl backgroundImage READ backgroundImage WRITE setBackgroundImage NOTIFY backgroundImageChanged)
+    Q_PROPERTY(QString format READ format WRITE setFormat NOTIFY formatChanged)
+    Q_PROPERTY(int quality READ quality WRITE setQuality NOTIFY qualityChanged)
+    Q_PROPERTY(int targetSize READ targetSize WRITE setTargetSize NOTIFY targetSizeChanged)
+    Q_PROPERTY(QStringList availableFormats READ availableFormats CONSTANT)
+    Q_PROPERTY(bool rendering READ rendering NOTIFY renderingChanged)
+
+public:
+    StickerRenderer(QObject *parent = 0);
+    ~StickerRenderer();
+
+    void setText(const QString &text);
+    QString text() const;
+
+    void setPoet(const QString &poet);
+    QString poet() const;
+
+    void setRatio(qreal ratio);
+    qreal ratio() const;
+
+    void setBackgroundColor(const QColor &color);
+    QColor backgroundColor() const;
+
+    void setForegroundColor(const QColor &color);
+    QColor foregroundColor() const;
+
+    void setFontFamily(const QString &family);
+    QString fontFamily() const;
+
+    void setFontSize(int size);
+    int fontSize() const;
+
+    void setFontScale(qreal scale);
+    qreal fontScale() const;
+
+    void setStickerImage(const QUrl &url);
+    QUrl stickerImage() const;
+
+    void setStickerType(int type);
+    int stickerType() const;
+
+    void setLogoImage(const QUrl &url);
+    QUrl logoImage() const;
+
+    void setBackgroundImage(const QUrl &url);
+    QUrl backgroundImage() const;
+
+    void setFormat(const QString &format);
+    QString format() const;
+
+    void setQuality(int quality);
+    int quality() const;
+
+    void setTargetSize(int bytes);
+    int targetSize() const;
+
+    static QStringList availableFormats();
+    bool rendering() const;
+
+    static QImage render(const StickerRenderOptions &options, const QSize &size);
+    static QImage render(const StickerRenderOptions &options, const QSize &size, StickerRenderResources *resources);
+    static QImage downscale(const QImage &image, const QSize &size);
+    static QByteArray encode(const QImage &image, const StickerOutputOptions &output);
+    static QStringList write(const StickerRenderOptions &options, const QList<QSize> &sizes, const QString &dest,
+                             const StickerOutputOptions &output, QSharedPointer<StickerRenderResources> resources);
+
+public slots:
+    void save(const QString &dest, const QVariantList &widths);
+    void saveBatch(const QString &dest, const QStringList &texts, int width);
+
+signals:
+    void textChanged();
+    void poetChanged();
+    void ratioChanged();
+    void backgroundColorChanged();
+    void foregroundColorChanged();
+    void fontFamilyChanged();
+    void fontSizeChanged();
+    void fontScaleChanged();
+    void stickerImageChanged();
+    void stickerTypeChanged();
+    void logoImageChanged();
+    void backgroundImageChanged();
+    void formatChanged();
+    void qualityChanged();
+    void targetSizeChanged();
+    void renderingChanged();
+
+    void saved(const QString &dest);
+    void progress(int done, int total);
+    void finished(const QStringList &files);
+    void failed();
+
+private:
+    bool begin(int count);
+    void startJob(const StickerRenderOptions &options, const QList<QSize> &sizes, const QString &dest,
+                  QSharedPointer<StickerRenderResources> resources);
+
+private:
+    StickerRendererPrivate *p;
+};
+
+#endif // STICKERRENDERER_H
@@ -18,6 +18,7 @@
 
 #define DESTROY_QUERY \
     if(p->find_query) { \
+        p->find_query->finish(); \
         delete p->find_query; \
         p->find_query = 0; \
     }
@@ -25,6 +26,9 @@
 #include "threadeddatabase.h"
 #include "meikadedatabase.h"
 #include "meikade_macros.h"
+#include "databaseconnectionpool.h"
+#include "versecodec.h"
+#include "poemcorpus.h"
 
 #include <QMutex>
 #include <QSqlDatabase>
@@ -32,7 +36,6 @@
 #include <QSqlRecord>
 #include <QSqlError>
 #include <QDir>
-#include <QUuid>
 #include <QTimer>
 #include <QVariant>
 #include <QDebug>
@@ -47,10 +50,12 @@ public:
     bool reset;
     bool terminate;
 
-    QString connectionName;
+    QString dbPath;
+    VerseCodec codec;
+    QSharedPointer<PoemCorpus> corpus;
+    PoemCorpusCursor cursor;
 
     QMutex mutex;
-    QSqlDatabase db;
     MeikadeDatabase *pdb;
 
     QSqlQuery *find_query;
@@ -75,8 +80,9 @@ ThreadedDatabase::ThreadedDatabase( MeikadeDatabase *pdb, QObject *parent) :
             if(!p->pdb->initialized())
                 return;
 
-            p->db.close();
-            p->connectionName.clear();
+            p->mutex.lock();
+            p->dbPath.clear();
+            p->mutex.unlock();
             initialize();
         });
 
@@ -89,15 +95,13 @@ ThreadedDatabase::ThreadedDatabase( MeikadeDatabase *pdb, QObject *parent) :
 
 void ThreadedDatabase::initialize()
 {
-    if(!p->connectionName.isEmpty() || !p->pdb)
+    if(!p->pdb)
         return;
 
-    QString dbPath = p->pdb->databasePath();
-    p->connectionName = QUuid::createUuid().toString();
-
-    p->db = QSqlDatabase::addDatabase( "QSQLITE", p->connectionName );
-    p->db.setDatabaseName(dbPath);
-    p->db.open();
+    p->mutex.lock();
+    if(p->dbPath.isEmpty())
+        p->dbPath = p->pdb->databasePath();
+    p->mutex.unlock();
 }
 
 void ThreadedDatabase::terminateThread()
@@ -148,18 +152,43 @@ void ThreadedDatabase::run()
         if( p->reset )
         {
             p->mutex.lock();
-            if(p->find_query)
-                delete p->find_query;
-
-            p->find_query = new QSqlQuery(p->db);
+            DESTROY_QUERY
+            p->corpus = PoemCorpus::corpus(p->dbPath);
+            p->cursor = PoemCorpusCursor();
+            p->codec = VerseCodec::codec(p->dbPath);
+            if(p->corpus)
+            {
+                p->reset = false;
+                i = -1;
+                p->mutex.unlock();
+                continue;
+            }
+            else
+            if(!p->codec.isNull())
+            {
+                // Compressed texts can't be matched by LIKE, they are decoded
+                // and matched while stepping through the rows below.
+                if(p->poet == -1)
+                    p->find_query = new QSqlQuery( DatabaseConnectionPool::query(p->dbPath,
+                                                   "SELECT poem_id, vorder, text FROM verse") );
+                else
+                {
+                    p->find_query = new QSqlQuery( DatabaseConnectionPool::query(p->dbPath,
+                                                   "SELECT poem_id, vorder, text FROM verse WHERE poet=:poet") );
+                    p->find_query->bindValue(":poet", p->poet);
+                }
+            }
+            else
             if(p->poet == -1)
             {
-                p->find_query->prepare("SELECT poem_id, vorder FROM verse WHERE text LIKE :keyword");
+                p->find_query = new QSqlQuery( DatabaseConnectionPool::query(p->dbPath,
+                                               "SELECT poem_id, vorder FROM verse WHERE text LIKE :keyword") );
                 p->find_query->bindValue(":keyword","%" + p->keyword + "%");
             }
             else
             {
-                p->find_query->prepare("SELECT poem_id, vorder FROM verse WHERE poet=:poet AND text LIKE :keyword");
+                p->find_query = new QSqlQuery( DatabaseConnectionPool::query(p->dbPath,
+                                               "SELECT poem_id, vorder FROM verse WHERE poet=:poet AND text LIKE :keyword") );
                 p->find_query->bindValue(":keyword","%" + p->keyword + "%");
                 p->find_query->bindValue(":poet", p->poet);
             }
@@ -169,10 +198,46 @@ void ThreadedDatabase::run()
             p->mutex.unlock();
             p->find_query->exec();
         }
+        if(p->corpus)
+        {
+            int poemId = 0;
+            int vorder = 0;
+            if(p->corpus->findNext(p->keyword, p->poet, p->cursor, poemId, vorder, &p->terminate, &p->reset))
+            {
+                if( !p->reset )
+                    emit found(poemId, vorder);
+                p->pointer++;
+                continue;
+            }
+
+            if(p->terminate || p->reset)
+            {
+                i--;
+                continue;
+            }
+
+            p->corpus.clear();
+            p->length = -1;
+            emit noMoreResult();
+            return;
+        }
+
         if(!p->find_query)
             return;
 
-        if( !p->find_query->next() )
+        bool hasNext = p->find_query->next();
+        if(!p->codec.isNull())
+            while(hasNext && !p->reset && !p->terminate &&
+                  !p->codec.decode(p->find_query->value(2).toString()).contains(p->keyword, Qt::CaseInsensitive))
+                hasNext = p->find_query->next();
+
+        if(p->terminate || p->reset)
+        {
+            i--;
+            continue;
+        }
+
+        if( !hasNext )
         {
             DESTROY_QUERY
             p->length = -1;
@@ -190,10 +255,6 @@ void ThreadedDatabase::run()
 
 ThreadedDatabase::~ThreadedDatabase()
 {
-    if(p->find_query)
-        delete p->find_query;
-
-    QString connectionName = p->connectionName;
+    DESTROY_QUERY
     delete p;
-    QSqlDatabase::removeDatabase(connectionName);
 }
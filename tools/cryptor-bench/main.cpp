@@ -0,0 +1,204 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measures Encryptor::encrypt and Decryptor::decrypt for every algorithm and
+ * mode the backups may use, over a range of chunk sizes, and checks that the
+ * data survives a round trip, in one piece and streamed in odd sized pieces:
+ *
+ *     cryptor-bench [milliseconds-per-measurement]
+ *
+ * Throughput counts the plain text bytes only. The per call overhead is the
+ * time of a whole encrypt or decrypt call (mode setup, header and IV) on a
+ * single byte.
+ */
+
+#define BENCHMARK_DEFAULT_MSECS 300
+#define BENCHMARK_KEY "meikade-cryptor-bench"
+#define ROUND_TRIP_SIZE (1024*1024 + 37)
+
+#include "SimpleQtCryptor/simpleqtcryptor.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <QList>
+#include <QPair>
+
+using namespace SimpleQtCryptor;
+
+static QTextStream out(stdout);
+
+static QByteArray samplePlain(int size)
+{
+    QByteArray plain(size, 0);
+    for(int i=0; i<size; i++)
+        plain[i] = char((i * 2654435761u) >> 24);
+    return plain;
+}
+
+static QByteArray encrypt(QSharedPointer<Key> key, Algorithm algorithm, Mode mode, const QByteArray &plain)
+{
+    QByteArray cipher;
+    Encryptor enc(key, algorithm, mode, NoChecksum);
+    if(enc.encrypt(plain, cipher, true) != NoError)
+        return QByteArray();
+    return cipher;
+}
+
+static QByteArray decrypt(QSharedPointer<Key> key, Algorithm algorithm, Mode mode, const QByteArray &cipher)
+{
+    QByteArray plain;
+    Decryptor dec(key, algorithm, mode);
+    if(dec.decrypt(cipher, plain, true) != NoError)
+        return QByteArray();
+    return plain;
+}
+
+/*!
+ * Feeds the data in pieces of the given sizes, in turn, like a stream
+ * would, and only marks the last piece as the end.
+ */
+static QByteArray streamed(QSharedPointer<Key> key, Algorithm algorithm, Mode mode, const QByteArray &data,
+                           const QList<int> &pieces, bool encrypting)
+{
+    Encryptor enc(key, algorithm, mode, NoChecksum);
+    Decryptor dec(key, algorithm, mode);
+
+    QByteArray result;
+    int pos = 0;
+    int idx = 0;
+    while(pos < data.size())
+    {
+        const int len = qMin(pieces.at(idx++ % pieces.count()), data.size() - pos);
+        const bool end = (pos + len == data.size());
+
+        QByteArray output;
+        const Error error = encrypting? enc.encrypt(data.mid(pos, len), output, end)
+                                      : dec.decrypt(data.mid(pos, len), output, end);
+        if(error != NoError)
+            return QByteArray();
+
+        result += output;
+        pos += len;
+    }
+
+    return result;
+}
+
+static bool roundTrip(QSharedPointer<Key> key, Algorithm algorithm, Mode mode, QString *failure)
+{
+    const QByteArray plain = samplePlain(ROUND_TRIP_SIZE);
+    const QList<int> pieces = QList<int>() << 1 << 7 << 13 << 4099 << 16 << 65536;
+
+    const QByteArray cipher = encrypt(key, algorithm, mode, plain);
+    if(cipher.isEmpty() || cipher.contains(plain.left(64)))
+        *failure = "encrypt";
+    else if(decrypt(key, algorithm, mode, cipher) != plain)
+        *failure = "decrypt";
+    else if(streamed(key, algorithm, mode, cipher, pieces, false) != plain)
+        *failure = "streamed decrypt";
+    else if(decrypt(key, algorithm, mode, streamed(key, algorithm, mode, plain, pieces, true)) != plain)
+        *failure = "streamed encrypt";
+    else
+        return true;
+
+    return false;
+}
+
+/*!
+ * Repeats the call on the chunk for about msecs milliseconds and returns
+ * the average nanoseconds per call.
+ */
+static double measure(QSharedPointer<Key> key, Algorithm algorithm, Mode mode, const QByteArray &chunk,
+                      bool encrypting, int msecs)
+{
+    const QByteArray input = encrypting? chunk : encrypt(key, algorithm, mode, chunk);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 calls = 0;
+    do {
+        if(encrypting)
+            encrypt(key, algorithm, mode, input);
+        else
+            decrypt(key, algorithm, mode, input);
+        calls++;
+    } while(timer.elapsed() < msecs);
+
+    return double(timer.nsecsElapsed()) / calls;
+}
+
+static double megabytesPerSecond(int bytes, double nsecsPerCall)
+{
+    return (bytes / 1048576.0) / (nsecsPerCall / 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList &args = app.arguments();
+    const int msecs = (args.count() > 1? qMax(1, args.at(1).toInt()) : BENCHMARK_DEFAULT_MSECS);
+
+    QList< QPair<Algorithm,QString> > algorithms;
+    algorithms << qMakePair(SERPENT_32, QString("SERPENT_32"));
+#ifdef WITHRC5
+    algorithms << qMakePair(RC5_32_32_20, QString("RC5_32_32_20"));
+    algorithms << qMakePair(RC5_64_32_20, QString("RC5_64_32_20"));
+#endif
+
+    QList< QPair<Mode,QString> > modes;
+    modes << qMakePair(ModeCBC, QString("CBC"));
+    modes << qMakePair(ModeCFB, QString("CFB"));
+
+    const QList<int> chunkSizes = QList<int>() << 16 << 256 << 4096 << 65536 << 1024*1024;
+    QSharedPointer<Key> key(new Key(QString(BENCHMARK_KEY)));
+
+    out << "Serpent kernel: " << serpent_kernel_name(serpent_kernel()) << endl;
+    out << "algorithm\tmode\tchunk\tencrypt MB/s\tdecrypt MB/s" << endl;
+
+    int failures = 0;
+    for(const QPair<Algorithm,QString> &algorithm: algorithms)
+        for(const QPair<Mode,QString> &mode: modes)
+        {
+            QString failure;
+            if(!roundTrip(key, algorithm.first, mode.first, &failure))
+            {
+                out << algorithm.second << "\t" << mode.second << "\tROUND TRIP FAILED: " << failure << endl;
+                failures++;
+                continue;
+            }
+
+            const QByteArray single = samplePlain(1);
+            out << algorithm.second << "\t" << mode.second << "\tper call\t"
+                << measure(key, algorithm.first, mode.first, single, true, msecs) / 1000 << " us\t"
+                << measure(key, algorithm.first, mode.first, single, false, msecs) / 1000 << " us" << endl;
+
+            for(int size: chunkSizes)
+            {
+                const QByteArray chunk = samplePlain(size);
+                out << algorithm.second << "\t" << mode.second << "\t" << size << "\t"
+                    << megabytesPerSecond(size, measure(key, algorithm.first, mode.first, chunk, true, msecs)) << "\t"
+                    << megabytesPerSecond(size, measure(key, algorithm.first, mode.first, chunk, false, msecs)) << endl;
+            }
+        }
+
+    return failures;
+}
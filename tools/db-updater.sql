@@ -15,4 +15,15 @@ INSERT INTO verse SELECT * FROM verse_tmp;
 DROP TABLE verse_tmp;
 UPDATE verse SET poet=(SELECT id FROM poet LIMIT 1);
 
-COMMIT;
\ No newline at end of file
+DROP INDEX IF EXISTS verse_pid;
+DROP INDEX IF EXISTS poem_cid;
+DROP INDEX IF EXISTS cat_pid;
+CREATE INDEX verse_poem_covering ON verse(poem_id, vorder, position);
+CREATE INDEX poem_cat_covering ON poem(cat_id, id, title, url);
+CREATE INDEX cat_parent_covering ON cat(parent_id, id);
+CREATE INDEX cat_poet_covering ON cat(poet_id, id);
+CREATE INDEX verse_poet ON verse(poet);
+
+COMMIT;
+
+ANALYZE;
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares the Serpent kernels on raw blocks and on CBC/CFB decryption of
+ * the same cipher text against the one block at a time path, and checks
+ * that every kernel restores the original plain text:
+ *
+ *     serpent-bench [megabytes]
+ */
+
+#define BENCHMARK_DEFAULT_MB 16
+#define BENCHMARK_KEY "meikade-serpent-bench"
+
+#include "SimpleQtCryptor/simpleqtcryptor.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+#include <cstring>
+
+using namespace SimpleQtCryptor;
+
+static QTextStream out(stdout);
+
+static double megabytesPerSecond(qint64 bytes, qint64 nsecs)
+{
+    return nsecs? (bytes / 1048576.0) / (nsecs / 1e9) : 0;
+}
+
+static QByteArray encrypt(QSharedPointer<Key> key, Mode mode, const QByteArray &plain)
+{
+    QByteArray cipher;
+    Encryptor enc(key, SERPENT_32, mode, NoChecksum);
+    enc.encrypt(plain, cipher, true);
+    return cipher;
+}
+
+static QByteArray decrypt(QSharedPointer<Key> key, Mode mode, const QByteArray &cipher, qint64 *nsecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray plain;
+    Decryptor dec(key, SERPENT_32, mode);
+    dec.decrypt(cipher, plain, true);
+
+    *nsecs = timer.nsecsElapsed();
+    return plain;
+}
+
+/*!
+ * The reference: one serpent_decrypt_16b() call per block, the way the
+ * library decrypted before the 4 block kernels.
+ */
+static qint64 blocksReference(QSharedPointer<Key> key, QByteArray data)
+{
+    uchar *dat = (uchar *)data.data();
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i+16<=data.size(); i+=16)
+        serpent_decrypt_16b(dat + i, dat + i, key->serpent);
+
+    return timer.nsecsElapsed();
+}
+
+static qint64 blocksKernel(QSharedPointer<Key> key, const QByteArray &data)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    quint32 X[16];
+    const uchar *dat = (const uchar *)data.constData();
+    for(int i=0; i+64<=data.size(); i+=64)
+    {
+        memcpy(X, dat + i, sizeof(X));
+        serpent_decrypt_4x(X, key->serpent);
+    }
+
+    return timer.nsecsElapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList &args = app.arguments();
+
+    const int megabytes = (args.count() > 1? args.at(1).toInt() : BENCHMARK_DEFAULT_MB);
+    const int size = qMax(1, megabytes) * 1048576 + 37;
+
+    QByteArray plain(size, 0);
+    for(int i=0; i<size; i++)
+        plain[i] = char((i * 2654435761u) >> 24);
+
+    QSharedPointer<Key> key(new Key(QString(BENCHMARK_KEY)));
+    const QByteArray cbc = encrypt(key, ModeCBC, plain);
+    const QByteArray cfb = encrypt(key, ModeCFB, plain);
+
+    out << "Blocks, serpent_decrypt_16b: "
+        << megabytesPerSecond(size, blocksReference(key, plain)) << " MB/s" << endl;
+
+    int failures = 0;
+    for(int k=SerpentScalar; k<=SerpentSimd; k++)
+    {
+        const SerpentKernel kernel = static_cast<SerpentKernel>(k);
+        const QString name = QString::fromLatin1(serpent_kernel_name(kernel));
+        if(!serpent_set_kernel(kernel))
+        {
+            out << name << ": not available" << endl;
+            continue;
+        }
+
+        out << name << ":" << endl;
+        out << "\tblocks\t" << megabytesPerSecond(size, blocksKernel(key, plain)) << " MB/s" << endl;
+
+        qint64 nsecs = 0;
+        const bool cbcOk = (decrypt(key, ModeCBC, cbc, &nsecs) == plain);
+        out << "\tCBC\t" << megabytesPerSecond(size, nsecs) << " MB/s\t" << (cbcOk? "ok" : "MISMATCH") << endl;
+
+        const bool cfbOk = (decrypt(key, ModeCFB, cfb, &nsecs) == plain);
+        out << "\tCFB\t" << megabytesPerSecond(size, nsecs) << " MB/s\t" << (cfbOk? "ok" : "MISMATCH") << endl;
+
+        if(!cbcOk || !cfbOk)
+            failures++;
+    }
+
+    serpent_set_kernel(SerpentAuto);
+    out << "Default kernel: " << serpent_kernel_name(serpent_kernel()) << endl;
+    return failures;
+}
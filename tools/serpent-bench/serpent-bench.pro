@@ -0,0 +1,17 @@
+QT += core
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = serpent-bench
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../SimpleQtCryptor/simpleqtcryptor.cpp
+
+HEADERS += \
+    ../../SimpleQtCryptor/simpleqtcryptor.h \
+    ../../SimpleQtCryptor/serpent_sbox.h
@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Renders a sample sticker and reports the size and encode time of every
+ * available output format, with and without a target size:
+ *
+ *     sticker-bench [background-image] [target-bytes]
+ */
+
+#define BENCHMARK_WIDTH 1280
+#define BENCHMARK_ROUNDS 5
+
+#include "stickerrenderer.h"
+#include "stickermodel.h"
+
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+static QTextStream out(stdout);
+
+static void benchmark(const QImage &image, const StickerOutputOptions &output)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray data;
+    for(int i=0; i<BENCHMARK_ROUNDS; i++)
+        data = StickerRenderer::encode(image, output);
+
+    out << output.format << "\tquality " << output.quality << "\ttarget " << output.targetSize
+        << "\t" << data.size() << " bytes\t" << timer.elapsed()/BENCHMARK_ROUNDS << "ms" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    const QStringList &args = app.arguments();
+
+    StickerRenderOptions options;
+    options.text = QString::fromUtf8("بشنو این نی چون شکایت می‌کند\nاز جدایی‌ها حکایت می‌کند");
+    options.poet = QString::fromUtf8("مولوی");
+    options.backgroundColor = QColor("#ebc220");
+    options.foregroundColor = QColor("#1b1b1b");
+    options.stickerType = StickerModel::StickerDouble;
+    if(args.count() > 1)
+        options.backgroundImage = QUrl::fromLocalFile(args.at(1));
+
+    const int target = (args.count() > 2? args.at(2).toInt() : 200*1024);
+
+    QElapsedTimer timer;
+    timer.start();
+    const QImage &image = StickerRenderer::render(options, QSize(BENCHMARK_WIDTH, BENCHMARK_WIDTH));
+    out << "Render " << BENCHMARK_WIDTH << "px: " << timer.elapsed() << "ms" << endl;
+
+    timer.restart();
+    const QImage &linear = StickerRenderer::downscale(image, image.size()/2);
+    out << "Linear light downscale: " << timer.elapsed() << "ms" << endl;
+
+    timer.restart();
+    const QImage &smooth = image.scaled(image.size()/2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    out << "Smooth downscale: " << timer.elapsed() << "ms" << endl;
+    Q_UNUSED(linear)
+    Q_UNUSED(smooth)
+
+    for(const QString &format: StickerRenderer::availableFormats())
+    {
+        StickerOutputOptions output;
+        output.format = format;
+        benchmark(image, output);
+
+        if(format == "png")
+            continue;
+
+        output.quality = 75;
+        benchmark(image, output);
+
+        output.quality = -1;
+        output.targetSize = target;
+        benchmark(image, output);
+    }
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+QT += core gui concurrent
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = sticker-bench
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../stickerrenderer.cpp
+
+HEADERS += \
+    ../../stickerrenderer.h
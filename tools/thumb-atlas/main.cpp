@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Packs a directory of "<poet>.png" thumbnails into atlas sheets and
+ * compares loading them with decoding every thumbnail on its own:
+ *
+ *     thumb-atlas <thumbs-dir> <destination>
+ */
+
+#include "poetthumbnailatlas.h"
+
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QStringList>
+#include <QTextStream>
+#include <QDir>
+
+static QTextStream out(stdout);
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    const QStringList &args = app.arguments();
+    if(args.count() < 3)
+    {
+        out << "Usage: thumb-atlas <thumbs-dir> <destination>" << endl;
+        return 1;
+    }
+
+    const QString &source = args.at(1);
+    const QString &destination = args.at(2);
+
+    QElapsedTimer timer;
+    timer.start();
+    const PoetThumbnailAtlas &generated = PoetThumbnailAtlas::generate(source, destination);
+    out << "Packed " << generated.count() << " thumbnails in " << timer.elapsed() << "ms" << endl;
+
+    timer.restart();
+    int decoded = 0;
+    const QStringList &files = QDir(source).entryList(QStringList() << "*.png", QDir::Files);
+    for(const QString &file: files)
+        if(!QImageReader(source + "/" + file).read().isNull())
+            decoded++;
+    out << "Separate decode: " << decoded << " images, " << timer.elapsed() << "ms" << endl;
+
+    timer.restart();
+    PoetThumbnailAtlas atlas;
+    atlas.load(destination);
+    out << "Atlas load: " << atlas.count() << " images, " << timer.elapsed() << "ms" << endl;
+
+    return 0;
+}
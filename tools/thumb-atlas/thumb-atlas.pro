@@ -0,0 +1,15 @@
+QT += core gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = thumb-atlas
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../poetthumbnailatlas.cpp
+
+HEADERS += \
+    ../../poetthumbnailatlas.h
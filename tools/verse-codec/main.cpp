@@ -0,0 +1,224 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Builds a dictionary compressed copy of data.sqlite and compares it with the
+ * plain database:
+ *
+ *     verse-codec <data.sqlite> <compressed.sqlite> [keyword]
+ */
+
+#define BENCHMARK_OPEN_ROUNDS 20
+#define BENCHMARK_POEM_ID 2130
+
+#include "versecodec.h"
+
+#include <QCoreApplication>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFile>
+#include <QStringList>
+#include <QVariant>
+#include <QTextStream>
+#include <QUuid>
+
+static QTextStream out(stdout);
+
+class BenchmarkResult
+{
+public:
+    BenchmarkResult(): size(0), openMs(0), scanMs(0), scanBytes(0), rows(0), matches(0) {}
+
+    qint64 size;
+    qreal openMs;
+    qint64 scanMs;
+    qint64 scanBytes;
+    qint64 rows;
+    qint64 matches;
+};
+
+static QSqlDatabase openDatabase(const QString &path)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", QUuid::createUuid().toString());
+    db.setDatabaseName(path);
+    if(!db.open())
+        out << db.lastError().text() << endl;
+
+    return db;
+}
+
+static void closeDatabase(QSqlDatabase &db)
+{
+    const QString name = db.connectionName();
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
+
+static BenchmarkResult benchmark(const QString &path, const QString &keyword)
+{
+    BenchmarkResult result;
+    result.size = QFileInfo(path).size();
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<BENCHMARK_OPEN_ROUNDS; i++)
+    {
+        QSqlDatabase db = openDatabase(path);
+        const VerseCodec codec = VerseCodec::load(db);
+
+        QSqlQuery query(db);
+        query.prepare("SELECT text FROM verse WHERE poem_id=:pid");
+        query.bindValue(":pid", BENCHMARK_POEM_ID);
+        query.exec();
+        while(query.next())
+            codec.decode(query.value(0).toString());
+
+        query.finish();
+        query = QSqlQuery();
+        closeDatabase(db);
+    }
+    result.openMs = timer.nsecsElapsed()/1000000.0/BENCHMARK_OPEN_ROUNDS;
+
+    QSqlDatabase db = openDatabase(path);
+    const VerseCodec codec = VerseCodec::load(db);
+
+    timer.restart();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.exec("SELECT text FROM verse");
+    while(query.next())
+    {
+        const QString &text = codec.decode(query.value(0).toString());
+        result.scanBytes += text.size()*2;
+        result.rows++;
+        if(text.contains(keyword, Qt::CaseInsensitive))
+            result.matches++;
+    }
+    result.scanMs = timer.elapsed();
+
+    query = QSqlQuery();
+    closeDatabase(db);
+    return result;
+}
+
+static bool compress(const QString &path)
+{
+    QSqlDatabase db = openDatabase(path);
+    if(!db.isOpen())
+        return false;
+
+    out << "Training dictionary..." << endl;
+
+    QHash<QString, qint64> frequencies;
+    QSqlQuery scan(db);
+    scan.setForwardOnly(true);
+    scan.exec("SELECT text FROM verse");
+    while(scan.next())
+        for(const QString &word: scan.value(0).toString().split(QLatin1Char(' ')))
+            frequencies[word]++;
+    scan.finish();
+
+    const VerseCodec codec(VerseCodec::train(frequencies));
+    out << "Dictionary words: " << codec.words().count() << endl;
+
+    out << "Encoding verses..." << endl;
+    db.transaction();
+
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    select.exec("SELECT rowid, text FROM verse");
+
+    QSqlQuery update(db);
+    update.prepare("UPDATE verse SET text=:text WHERE rowid=:rowid");
+    while(select.next())
+    {
+        update.bindValue(":text", codec.encode(select.value(1).toString()));
+        update.bindValue(":rowid", select.value(0));
+        if(!update.exec())
+        {
+            out << update.lastError().text() << endl;
+            db.rollback();
+            return false;
+        }
+    }
+    select.finish();
+
+    if(!codec.save(db))
+    {
+        db.rollback();
+        return false;
+    }
+    db.commit();
+
+    out << "Vacuuming..." << endl;
+    QSqlQuery vacuum(db);
+    vacuum.exec("VACUUM");
+
+    select = QSqlQuery();
+    update = QSqlQuery();
+    vacuum = QSqlQuery();
+    closeDatabase(db);
+    return true;
+}
+
+static void print(const QString &name, const BenchmarkResult &result)
+{
+    const qreal mb = 1024.0*1024.0;
+    out << QString("%1 %2 MB  open+first poem %3 ms  scan %4 ms (%5 MB/s, %6 rows/s, %7 matches)")
+           .arg(name, -12)
+           .arg(result.size/mb, 8, 'f', 2)
+           .arg(result.openMs, 6, 'f', 2)
+           .arg(result.scanMs, 6)
+           .arg(result.scanMs? result.scanBytes/mb*1000/result.scanMs : 0, 7, 'f', 1)
+           .arg(result.scanMs? result.rows*1000/result.scanMs : 0)
+           .arg(result.matches) << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if(args.count() < 3)
+    {
+        out << "Usage: verse-codec <data.sqlite> <compressed.sqlite> [keyword]" << endl;
+        return 1;
+    }
+
+    const QString plain = args.at(1);
+    const QString compressed = args.at(2);
+    const QString keyword = args.count() > 3? args.at(3) : QString::fromUtf8("عشق");
+
+    QFile::remove(compressed);
+    if(!QFile::copy(plain, compressed))
+    {
+        out << "Can't copy " << plain << endl;
+        return 1;
+    }
+
+    if(!compress(compressed))
+        return 1;
+
+    print("plain", benchmark(plain, keyword));
+    print("compressed", benchmark(compressed, keyword));
+    return 0;
+}
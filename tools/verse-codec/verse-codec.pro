@@ -0,0 +1,18 @@
+QT += core sql
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = verse-codec
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../versecodec.cpp \
+    ../../databaseconnectionpool.cpp
+
+HEADERS += \
+    ../../versecodec.h \
+    ../../databaseconnectionpool.h
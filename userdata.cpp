@@ -16,9 +16,13 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define USERDATA_FLUSH_INTERVAL 2000
+
 #include "userdata.h"
 #include "meikade.h"
 #include "meikade_macros.h"
+#include "userdatachangelog.h"
+#include "userdatawriter.h"
 
 #include <QSqlDatabase>
 #include <QSqlQuery>
@@ -29,16 +33,53 @@
 #include <QSet>
 #include <QFile>
 #include <QMap>
+#include <QPair>
 #include <QVariant>
 #include <QDateTime>
+#include <QThread>
+#include <QTimer>
 #include <QDebug>
 #include <QCoreApplication>
+#include <QGuiApplication>
+
+/*!
+ * (poem_id, vorder) packed in one 64 bit key, the poem in the high half.
+ */
+static inline quint64 userDataKey(int pid, int vid)
+{
+    return (static_cast<quint64>(static_cast<quint32>(pid)) << 32) | static_cast<quint32>(vid);
+}
+
+static inline QString userDataStringId(quint64 key)
+{
+    return QString("%1:%2").arg(static_cast<qint32>(key >> 32)).arg(static_cast<qint32>(key & 0xffffffff));
+}
+
+class UserDataNote
+{
+public:
+    QString text;
+    qint64 date;
+};
 
 class UserDataPrivates
 {
 public:
     QSqlDatabase db;
     QString path;
+
+    // favorited and noted verses with their dates, so no read needs a
+    // query. Reloaded on reconnect, updated by every write.
+    QHash<quint64, qint64> favorites;
+    QHash<quint64, UserDataNote> notes;
+
+    // writes are behind: the latest mutation of every row waits here and
+    // goes to the writer thread in one batch. Held while disconnected.
+    QHash< QPair<int,quint64>, UserDataMutation > pending;
+    bool connected;
+    QTimer *flushTimer;
+    QThread *thread;
+    UserDataWriter *writer;
 };
 
 UserData::UserData(QObject *parent) :
@@ -56,6 +97,26 @@ UserData::UserData(QObject *parent) :
     Meikade::settings()->setValue("initialize/userdata_db",true);
     QFile(p->path).setPermissions(QFileDevice::WriteOwner|QFileDevice::WriteGroup|QFileDevice::ReadUser|QFileDevice::ReadGroup);
 
+    qRegisterMetaType<UserDataMutations>("UserDataMutations");
+
+    p->thread = new QThread();
+    p->writer = new UserDataWriter(p->path);
+    p->writer->moveToThread(p->thread);
+    p->thread->start();
+    p->connected = false;
+
+    p->flushTimer = new QTimer(this);
+    p->flushTimer->setSingleShot(true);
+    p->flushTimer->setInterval(USERDATA_FLUSH_INTERVAL);
+
+    connect( p->flushTimer, SIGNAL(timeout()), SLOT(flush()) );
+    connect( p->writer, SIGNAL(failed(UserDataMutations)), SLOT(writeFailed(UserDataMutations)), Qt::QueuedConnection );
+    connect( qApp, SIGNAL(aboutToQuit()), SLOT(sync()) );
+    connect( qGuiApp, &QGuiApplication::applicationStateChanged, this, [this](Qt::ApplicationState state){
+        if( state != Qt::ApplicationActive )
+            sync();
+    });
+
     p->db = QSqlDatabase::addDatabase("QSQLITE",USERDATAS_DB_CONNECTION);
     p->db.setDatabaseName(p->path);
     reconnect();
@@ -63,61 +124,162 @@ UserData::UserData(QObject *parent) :
 
 void UserData::disconnect()
 {
+    sync();
+    p->connected = false;
+    QMetaObject::invokeMethod( p->writer, "close", Qt::BlockingQueuedConnection );
     p->db.close();
 }
 
+/*!
+ * The file may have been replaced meanwhile (a restore), so the index is
+ * reloaded and the changes made while disconnected go on top of it.
+ */
 void UserData::reconnect()
 {
     p->db.open();
+    p->connected = true;
+    loadIndex();
+    applyPending();
+    flush();
+}
+
+void UserData::loadIndex()
+{
+    p->favorites.clear();
+    p->notes.clear();
+
+    QSqlQuery favorites(p->db);
+    favorites.prepare("SELECT poem_id, vorder, date FROM favorites");
+    favorites.exec();
+    while( favorites.next() )
+    {
+        const QSqlRecord &record = favorites.record();
+        p->favorites.insert( userDataKey(record.value(0).toInt(), record.value(1).toInt()), record.value(2).toLongLong() );
+    }
+
+    QSqlQuery notes(p->db);
+    notes.prepare("SELECT poem_id, vorder, text, date FROM notes");
+    notes.exec();
+    while( notes.next() )
+    {
+        const QSqlRecord &record = notes.record();
+        UserDataNote note;
+        note.text = record.value(2).toString();
+        note.date = record.value(3).toLongLong();
+        p->notes.insert( userDataKey(record.value(0).toInt(), record.value(1).toInt()), note );
+    }
+}
+
+void UserData::applyPending()
+{
+    for( const UserDataMutation &mutation: p->pending )
+    {
+        const quint64 key = userDataKey(mutation.pid, mutation.vid);
+        if( mutation.table == UserDataChangeLog::Notes )
+        {
+            if( !mutation.present )
+            {
+                p->notes.remove(key);
+                continue;
+            }
+
+            UserDataNote note;
+            note.text = mutation.text;
+            note.date = mutation.date.toLongLong();
+            p->notes.insert(key, note);
+        }
+        else
+        if( mutation.present )
+            p->favorites.insert(key, mutation.date.toLongLong());
+        else
+            p->favorites.remove(key);
+    }
+}
+
+void UserData::enqueue(int table, int pid, int vid, bool present, const QString &text, qint64 date)
+{
+    UserDataMutation mutation;
+    mutation.table = table;
+    mutation.pid = pid;
+    mutation.vid = vid;
+    mutation.present = present;
+    mutation.text = text;
+    mutation.date = QString::number(date);
+
+    p->pending[ qMakePair(table, userDataKey(pid,vid)) ] = mutation;
+    if( !p->flushTimer->isActive() )
+        p->flushTimer->start();
+}
+
+void UserData::flush()
+{
+    p->flushTimer->stop();
+    if( p->pending.isEmpty() || !p->connected )
+        return;
+
+    const UserDataMutations mutations = p->pending.values();
+    p->pending.clear();
+    QMetaObject::invokeMethod( p->writer, "write", Qt::QueuedConnection, Q_ARG(UserDataMutations, mutations) );
+}
+
+void UserData::sync()
+{
+    p->flushTimer->stop();
+    if( !p->connected )
+        return;
+
+    // also waits for the batches queued before
+    const UserDataMutations mutations = p->pending.values();
+    p->pending.clear();
+    QMetaObject::invokeMethod( p->writer, "write", Qt::BlockingQueuedConnection, Q_ARG(UserDataMutations, mutations) );
+}
+
+/*!
+ * A batch the writer couldn't commit goes back to pending, behind any
+ * newer change of the same rows, and is tried again with the next flush.
+ */
+void UserData::writeFailed(const UserDataMutations &mutations)
+{
+    for( const UserDataMutation &mutation: mutations )
+    {
+        const QPair<int,quint64> key = qMakePair(mutation.table, userDataKey(mutation.pid, mutation.vid));
+        if( !p->pending.contains(key) )
+            p->pending.insert(key, mutation);
+    }
+
+    if( p->connected && !p->flushTimer->isActive() )
+        p->flushTimer->start();
 }
 
 void UserData::favorite(int pid, int vid)
 {
-    QSqlQuery query(p->db);
-    query.prepare("INSERT OR REPLACE INTO favorites (poem_id,vorder,date) VALUES (:pid,:vid,:date)");
-    query.bindValue(":pid",pid);
-    query.bindValue(":vid",vid);
-    query.bindValue(":date" ,QString::number(QDateTime::currentDateTime().toMSecsSinceEpoch()));
-    query.exec();
+    const qint64 date = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    p->favorites.insert( userDataKey(pid,vid), date );
+    enqueue( UserDataChangeLog::Favorites, pid, vid, true, QString(), date );
     emit favorited(pid,vid);
 }
 
 void UserData::unfavorite(int pid, int vid)
 {
-    QSqlQuery query(p->db);
-    query.prepare("DELETE FROM favorites WHERE poem_id=:pid AND vorder=:vid" );
-    query.bindValue(":pid",pid);
-    query.bindValue(":vid",vid);
-    query.exec();
+    p->favorites.remove( userDataKey(pid,vid) );
+    enqueue( UserDataChangeLog::Favorites, pid, vid, false );
     emit unfavorited(pid,vid);
 }
 
 bool UserData::isFavorited(int pid, int vid)
 {
-    QSqlQuery query(p->db);
-    query.prepare("SELECT poem_id FROM favorites WHERE poem_id=:pid AND vorder=:vid" );
-    query.bindValue(":pid",pid);
-    query.bindValue(":vid",vid);
-    query.exec();
-
-    return query.next();
+    return p->favorites.contains( userDataKey(pid,vid) );
 }
 
 QStringList UserData::favorites()
 {
     QMap<qint64,QString> result;
 
-    QSqlQuery query(p->db);
-    query.prepare("SELECT poem_id, vorder, date FROM favorites");
-    query.exec();
-
-    while( query.next() )
+    QHashIterator<quint64, qint64> i(p->favorites);
+    while( i.hasNext() )
     {
-        QSqlRecord record = query.record();
-        int pid = record.value(0).toInt();
-        int vid = record.value(1).toInt();
-        qint64 date = record.value(2).toInt();
-        result.insert( date, QString("%1:%2").arg(pid).arg(vid) );
+        i.next();
+        result.insert( i.value(), userDataStringId(i.key()) );
     }
 
     return result.values();
@@ -127,55 +289,39 @@ void UserData::setNote(int pid, int vid, const QString &note)
 {
     if( note.isEmpty() )
     {
-        QSqlQuery query(p->db);
-        query.prepare("DELETE FROM notes WHERE poem_id=:pid AND vorder=:vid" );
-        query.bindValue(":pid",pid);
-        query.bindValue(":vid",vid);
-        query.exec();
+        p->notes.remove( userDataKey(pid,vid) );
+        enqueue( UserDataChangeLog::Notes, pid, vid, false );
     }
     else
     {
-        QSqlQuery query(p->db);
-        query.prepare("INSERT OR REPLACE INTO notes (poem_id,vorder,text, date) VALUES (:pid,:vid,:note, :date)");
-        query.bindValue(":pid",pid);
-        query.bindValue(":vid",vid);
-        query.bindValue(":note" ,note);
-        query.bindValue(":date" ,QString::number(QDateTime::currentDateTime().toMSecsSinceEpoch()));
-        query.exec();
+        UserDataNote entry;
+        entry.text = note;
+        entry.date = QDateTime::currentDateTime().toMSecsSinceEpoch();
+        p->notes.insert( userDataKey(pid,vid), entry );
+        enqueue( UserDataChangeLog::Notes, pid, vid, true, entry.text, entry.date );
     }
     emit noteChanged(pid,vid);
 }
 
-QString UserData::note(int pid, int vid)
+bool UserData::hasNote(int pid, int vid)
 {
-    QSqlQuery query(p->db);
-    query.prepare("SELECT text FROM notes WHERE poem_id=:pid AND vorder=:vid");
-    query.bindValue(":pid",pid);
-    query.bindValue(":vid",vid);
-    query.exec();
-
-    if( !query.next() )
-        return QString();
+    return p->notes.contains( userDataKey(pid,vid) );
+}
 
-    QSqlRecord record = query.record();
-    return record.value(0).toString();
+QString UserData::note(int pid, int vid)
+{
+    return p->notes.value( userDataKey(pid,vid) ).text;
 }
 
 QStringList UserData::notes()
 {
     QMap<qint64,QString> result;
 
-    QSqlQuery query(p->db);
-    query.prepare("SELECT poem_id, vorder, date FROM notes");
-    query.exec();
-
-    while( query.next() )
+    QHashIterator<quint64, UserDataNote> i(p->notes);
+    while( i.hasNext() )
     {
-        QSqlRecord record = query.record();
-        int pid = record.value(0).toInt();
-        int vid = record.value(1).toInt();
-        qint64 date = record.value(2).toLongLong();
-        result.insert( date, QString("%1:%2").arg(pid).arg(vid) );
+        i.next();
+        result.insert( i.value().date, userDataStringId(i.key()) );
     }
 
     return result.values();
@@ -201,5 +347,11 @@ int UserData::extractVerseIdFromStringId(const QString &str_id)
 
 UserData::~UserData()
 {
+    sync();
+    QMetaObject::invokeMethod( p->writer, "close", Qt::BlockingQueuedConnection );
+    p->thread->quit();
+    p->thread->wait();
+    delete p->writer;
+    delete p->thread;
     delete p;
 }
@@ -19,6 +19,8 @@
 #ifndef USERDATA_H
 #define USERDATA_H
 
+#include "userdatawriter.h"
+
 #include <QObject>
 #include <QStringList>
 
@@ -37,6 +39,7 @@ public slots:
     QStringList favorites();
 
     void setNote( int pid, int vid, const QString & note );
+    bool hasNote( int pid, int vid );
     QString note( int pid, int vid );
     QStringList notes();
 
@@ -46,11 +49,23 @@ public slots:
     void disconnect();
     void reconnect();
 
+    /*! Writes every pending change and waits until it is committed. */
+    void sync();
+
 signals:
     void favorited( int pid, int vid );
     void unfavorited( int pid, int vid );
     void noteChanged( int pid, int vid );
 
+private slots:
+    void flush();
+    void writeFailed(const UserDataMutations &mutations);
+
+private:
+    void loadIndex();
+    void applyPending();
+    void enqueue(int table, int pid, int vid, bool present, const QString &text = QString(), qint64 date = 0);
+
 private:
     UserDataPrivates *p;
 };
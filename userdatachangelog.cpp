@@ -0,0 +1,225 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "userdatachangelog.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QStringList>
+#include <QVariant>
+#include <QDebug>
+
+class UserDataChange
+{
+public:
+    quint8 table;
+    qint32 pid;
+    qint32 vid;
+    bool present;
+    QString date;
+    QString text;
+};
+
+static bool changeLogExec(QSqlDatabase &db, const QString &sql)
+{
+    QSqlQuery query(db);
+    if(query.exec(sql))
+        return true;
+
+    qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+    return false;
+}
+
+bool UserDataChangeLog::init(QSqlDatabase db)
+{
+    QStringList queries;
+    queries << "CREATE TABLE IF NOT EXISTS changelog (seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "tbl INTEGER NOT NULL, poem_id INTEGER NOT NULL, vorder INTEGER NOT NULL)";
+
+    const QStringList tables = QStringList() << "favorites" << "notes";
+    for(int i=0; i<tables.count(); i++)
+    {
+        const QString &table = tables.at(i);
+        queries << QString("CREATE TRIGGER IF NOT EXISTS %1_log_insert AFTER INSERT ON %1 BEGIN "
+                           "INSERT INTO changelog (tbl,poem_id,vorder) VALUES (%2,NEW.poem_id,NEW.vorder); END").arg(table).arg(i)
+                << QString("CREATE TRIGGER IF NOT EXISTS %1_log_update AFTER UPDATE ON %1 BEGIN "
+                           "INSERT INTO changelog (tbl,poem_id,vorder) VALUES (%2,NEW.poem_id,NEW.vorder); "
+                           "INSERT INTO changelog (tbl,poem_id,vorder) SELECT %2,OLD.poem_id,OLD.vorder "
+                           "WHERE OLD.poem_id<>NEW.poem_id OR OLD.vorder<>NEW.vorder; END").arg(table).arg(i)
+                << QString("CREATE TRIGGER IF NOT EXISTS %1_log_delete AFTER DELETE ON %1 BEGIN "
+                           "INSERT INTO changelog (tbl,poem_id,vorder) VALUES (%2,OLD.poem_id,OLD.vorder); END").arg(table).arg(i);
+    }
+
+    for(const QString &sql: queries)
+        if(!changeLogExec(db, sql))
+            return false;
+
+    return true;
+}
+
+bool UserDataChangeLog::drop(QSqlDatabase db)
+{
+    QStringList queries;
+    const QStringList tables = QStringList() << "favorites" << "notes";
+    for(const QString &table: tables)
+        queries << QString("DROP TRIGGER IF EXISTS %1_log_insert").arg(table)
+                << QString("DROP TRIGGER IF EXISTS %1_log_update").arg(table)
+                << QString("DROP TRIGGER IF EXISTS %1_log_delete").arg(table);
+    queries << "DROP TABLE IF EXISTS changelog";
+
+    for(const QString &sql: queries)
+        if(!changeLogExec(db, sql))
+            return false;
+
+    return true;
+}
+
+qint64 UserDataChangeLog::sequence(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT seq FROM sqlite_sequence WHERE name='changelog'");
+    if(!query.exec() || !query.next())
+        return 0;
+
+    return query.record().value(0).toLongLong();
+}
+
+bool UserDataChangeLog::covers(QSqlDatabase db, qint64 since)
+{
+    if(since > sequence(db))
+        return false;
+
+    QSqlQuery query(db);
+    query.prepare("SELECT MIN(seq) FROM changelog WHERE seq>:since");
+    query.bindValue(":since", since);
+    if(!query.exec() || !query.next())
+        return false;
+
+    const QVariant &first = query.record().value(0);
+    return first.isNull() || first.toLongLong() == since+1;
+}
+
+bool UserDataChangeLog::writeDelta(QSqlDatabase db, qint64 since, QDataStream &stream)
+{
+    QSqlQuery changes(db);
+    changes.prepare("SELECT DISTINCT tbl, poem_id, vorder FROM changelog WHERE seq>:since");
+    changes.bindValue(":since", since);
+    if(!changes.exec())
+    {
+        qDebug() << __PRETTY_FUNCTION__ << changes.lastError().text();
+        return false;
+    }
+
+    QSqlQuery favorite(db);
+    favorite.prepare("SELECT date FROM favorites WHERE poem_id=:pid AND vorder=:vid");
+    QSqlQuery note(db);
+    note.prepare("SELECT date, text FROM notes WHERE poem_id=:pid AND vorder=:vid");
+
+    QList<UserDataChange> rows;
+    while(changes.next())
+    {
+        const QSqlRecord &record = changes.record();
+        UserDataChange change;
+        change.table = static_cast<quint8>(record.value(0).toInt());
+        change.pid = record.value(1).toInt();
+        change.vid = record.value(2).toInt();
+
+        QSqlQuery &current = (change.table == Notes? note : favorite);
+        current.bindValue(":pid", change.pid);
+        current.bindValue(":vid", change.vid);
+        if(!current.exec())
+            return false;
+
+        change.present = current.next();
+        if(change.present)
+        {
+            change.date = current.record().value(0).toString();
+            if(change.table == Notes)
+                change.text = current.record().value(1).toString();
+        }
+        current.finish();
+
+        rows << change;
+    }
+
+    stream << static_cast<quint32>(rows.count());
+    for(const UserDataChange &change: rows)
+        stream << change.table << change.pid << change.vid << change.present << change.date << change.text;
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool UserDataChangeLog::applyDelta(QSqlDatabase db, QDataStream &stream)
+{
+    quint32 count = 0;
+    stream >> count;
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    if(!db.transaction())
+        return false;
+
+    QSqlQuery insertFavorite(db);
+    insertFavorite.prepare("INSERT OR REPLACE INTO favorites (poem_id,vorder,date) VALUES (:pid,:vid,:date)");
+    QSqlQuery insertNote(db);
+    insertNote.prepare("INSERT OR REPLACE INTO notes (poem_id,vorder,text,date) VALUES (:pid,:vid,:note,:date)");
+    QSqlQuery removeFavorite(db);
+    removeFavorite.prepare("DELETE FROM favorites WHERE poem_id=:pid AND vorder=:vid");
+    QSqlQuery removeNote(db);
+    removeNote.prepare("DELETE FROM notes WHERE poem_id=:pid AND vorder=:vid");
+
+    for(quint32 i=0; i<count; i++)
+    {
+        UserDataChange change;
+        stream >> change.table >> change.pid >> change.vid >> change.present >> change.date >> change.text;
+        if(stream.status() != QDataStream::Ok || change.table > Notes)
+        {
+            db.rollback();
+            return false;
+        }
+
+        QSqlQuery &query = (change.table == Notes)? (change.present? insertNote : removeNote)
+                                                  : (change.present? insertFavorite : removeFavorite);
+        query.bindValue(":pid", change.pid);
+        query.bindValue(":vid", change.vid);
+        if(change.present)
+        {
+            query.bindValue(":date", change.date);
+            if(change.table == Notes)
+                query.bindValue(":note", change.text);
+        }
+
+        if(!query.exec())
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+
+    return db.commit();
+}
+
+void UserDataChangeLog::prune(QSqlDatabase db, qint64 sequence)
+{
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM changelog WHERE seq<=:seq");
+    query.bindValue(":seq", sequence);
+    query.exec();
+}
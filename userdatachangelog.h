@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERDATACHANGELOG_H
+#define USERDATACHANGELOG_H
+
+#include <QSqlDatabase>
+#include <QDataStream>
+
+/*!
+ * Records which favorites and notes of userdata.sqlite changed, so the
+ * incremental backups only have to carry those rows. Triggers on both
+ * tables append the (table, poem_id, vorder) of every insert, update and
+ * delete to the changelog table, with a growing sequence number.
+ *
+ * The log is only kept while there is a backup chain to feed: the backuper
+ * installs it with init() on its first backup and drops it on restore.
+ *
+ * A delta is the current state of every row changed after a sequence:
+ * the row itself, or its removal. Applying deltas in order on a copy of
+ * the database brings it to the state at the time of the last one.
+ */
+class UserDataChangeLog
+{
+public:
+    enum Table {
+        Favorites = 0,
+        Notes = 1
+    };
+
+    /*! Creates the changelog table and its triggers if missing. */
+    static bool init(QSqlDatabase db);
+
+    /*! Removes the changelog table and its triggers. */
+    static bool drop(QSqlDatabase db);
+
+    /*! The sequence of the latest change, pruned or not. 0 when nothing was logged. */
+    static qint64 sequence(QSqlDatabase db);
+
+    /*! True when every change after since is still in the log. */
+    static bool covers(QSqlDatabase db, qint64 since);
+
+    static bool writeDelta(QSqlDatabase db, qint64 since, QDataStream &stream);
+    static bool applyDelta(QSqlDatabase db, QDataStream &stream);
+
+    /*! Forgets the changes up to and including sequence. */
+    static void prune(QSqlDatabase db, qint64 sequence);
+};
+
+#endif // USERDATACHANGELOG_H
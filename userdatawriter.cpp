@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define USERDATA_WRITER_DB_CONNECTION "userdata_writer_sqlite"
+
+#include "userdatawriter.h"
+#include "userdatachangelog.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QDebug>
+
+class UserDataWriterPrivate
+{
+public:
+    QString path;
+};
+
+UserDataWriter::UserDataWriter(const QString &path, QObject *parent) :
+    QObject(parent)
+{
+    p = new UserDataWriterPrivate;
+    p->path = path;
+}
+
+void UserDataWriter::write(const UserDataMutations &mutations)
+{
+    if( mutations.isEmpty() )
+        return;
+
+    QSqlDatabase db = QSqlDatabase::database(USERDATA_WRITER_DB_CONNECTION, false);
+    if( !db.isValid() )
+    {
+        db = QSqlDatabase::addDatabase("QSQLITE", USERDATA_WRITER_DB_CONNECTION);
+        db.setDatabaseName(p->path);
+    }
+    if( (!db.isOpen() && !db.open()) || !db.transaction() )
+    {
+        qDebug() << __PRETTY_FUNCTION__ << db.lastError().text();
+        emit failed(mutations);
+        return;
+    }
+
+    QSqlQuery insertFavorite(db);
+    insertFavorite.prepare("INSERT OR REPLACE INTO favorites (poem_id,vorder,date) VALUES (:pid,:vid,:date)");
+    QSqlQuery insertNote(db);
+    insertNote.prepare("INSERT OR REPLACE INTO notes (poem_id,vorder,text, date) VALUES (:pid,:vid,:note, :date)");
+    QSqlQuery removeFavorite(db);
+    removeFavorite.prepare("DELETE FROM favorites WHERE poem_id=:pid AND vorder=:vid");
+    QSqlQuery removeNote(db);
+    removeNote.prepare("DELETE FROM notes WHERE poem_id=:pid AND vorder=:vid");
+
+    for( const UserDataMutation &mutation: mutations )
+    {
+        const bool notes = (mutation.table == UserDataChangeLog::Notes);
+        QSqlQuery &query = notes? (mutation.present? insertNote : removeNote)
+                                : (mutation.present? insertFavorite : removeFavorite);
+        query.bindValue(":pid", mutation.pid);
+        query.bindValue(":vid", mutation.vid);
+        if( mutation.present )
+        {
+            query.bindValue(":date", mutation.date);
+            if( notes )
+                query.bindValue(":note", mutation.text);
+        }
+
+        if( !query.exec() )
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            db.rollback();
+            emit failed(mutations);
+            return;
+        }
+    }
+
+    if( !db.commit() )
+    {
+        qDebug() << __PRETTY_FUNCTION__ << db.lastError().text();
+        db.rollback();
+        emit failed(mutations);
+    }
+}
+
+void UserDataWriter::close()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(USERDATA_WRITER_DB_CONNECTION, false);
+        if( !db.isValid() )
+            return;
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(USERDATA_WRITER_DB_CONNECTION);
+}
+
+UserDataWriter::~UserDataWriter()
+{
+    delete p;
+}
@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERDATAWRITER_H
+#define USERDATAWRITER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QMetaType>
+
+/*!
+ * The latest state of a favorite or note row: its values, or its removal
+ * when present is false. Table is one of UserDataChangeLog::Table.
+ */
+class UserDataMutation
+{
+public:
+    UserDataMutation() : table(0), pid(0), vid(0), present(false) {}
+
+    int table;
+    int pid;
+    int vid;
+    bool present;
+    QString text;
+    QString date;
+};
+
+typedef QList<UserDataMutation> UserDataMutations;
+Q_DECLARE_METATYPE(UserDataMutations)
+
+class UserDataWriterPrivate;
+
+/*!
+ * Writes batches of UserData mutations to userdata.sqlite on the thread it
+ * lives in, each batch in one transaction, so the GUI thread never waits
+ * on the database. The connection opens on the first write and close()
+ * releases it, e.g. before a backup replaces the file. A batch that can't
+ * be committed is rolled back and handed back with failed() for a retry.
+ */
+class UserDataWriter : public QObject
+{
+    Q_OBJECT
+public:
+    UserDataWriter(const QString &path, QObject *parent = 0);
+    ~UserDataWriter();
+
+public slots:
+    void write(const UserDataMutations &mutations);
+    void close();
+
+signals:
+    void failed(const UserDataMutations &mutations);
+
+private:
+    UserDataWriterPrivate *p;
+};
+
+#endif // USERDATAWRITER_H
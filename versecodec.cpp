@@ -0,0 +1,223 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define VERSE_CODEC_FIRST_CHAR 0xE000
+#define VERSE_CODEC_LAST_CHAR 0xF8FF
+#define VERSE_CODEC_NAME "dict-v1"
+
+#include "versecodec.h"
+#include "databaseconnectionpool.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QMap>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QVariant>
+#include <QDebug>
+
+static QMutex verse_codec_mutex;
+static QHash<QString, VerseCodec> verse_codec_cache;
+
+VerseCodec::VerseCodec(const QStringList &words) :
+    _words(words.mid(0, maximumSize()))
+{
+    for(int i=0; i<_words.count(); i++)
+        _indexes[_words.at(i)] = i;
+}
+
+QString VerseCodec::encode(const QString &text) const
+{
+    if(isNull())
+        return text;
+
+    QString result;
+    result.reserve(text.length());
+
+    int start = 0;
+    while(start <= text.length())
+    {
+        int end = text.indexOf(QLatin1Char(' '), start);
+        if(end == -1)
+            end = text.length();
+
+        const QString word = text.mid(start, end-start);
+        const int idx = _indexes.value(word, -1);
+        if(idx == -1)
+            result += word;
+        else
+            result += QChar(VERSE_CODEC_FIRST_CHAR + idx);
+
+        if(end < text.length())
+            result += QLatin1Char(' ');
+
+        start = end + 1;
+    }
+
+    return result;
+}
+
+QString VerseCodec::decode(const QString &text) const
+{
+    if(isNull())
+        return text;
+
+    const ushort last = VERSE_CODEC_FIRST_CHAR + _words.count();
+    const QChar *data = text.constData();
+    const int length = text.length();
+
+    int first = 0;
+    while(first < length && (data[first].unicode() < VERSE_CODEC_FIRST_CHAR || data[first].unicode() >= last))
+        first++;
+    if(first == length)
+        return text;
+
+    QString result = text.left(first);
+    result.reserve(length*4);
+    for(int i=first; i<length; i++)
+    {
+        const ushort c = data[i].unicode();
+        if(c >= VERSE_CODEC_FIRST_CHAR && c < last)
+            result += _words.at(c - VERSE_CODEC_FIRST_CHAR);
+        else
+            result += data[i];
+    }
+
+    return result;
+}
+
+QStringList VerseCodec::train(const QHash<QString, qint64> &frequencies, int size)
+{
+    QMultiMap<qint64, QString> gains;
+    for(QHash<QString, qint64>::const_iterator i=frequencies.constBegin(); i!=frequencies.constEnd(); i++)
+    {
+        const QString &word = i.key();
+        if(word.length() < 2)
+            continue;
+
+        bool encodable = true;
+        for(const QChar &c: word)
+            if(c.unicode() >= VERSE_CODEC_FIRST_CHAR && c.unicode() <= VERSE_CODEC_LAST_CHAR)
+            {
+                encodable = false;
+                break;
+            }
+        if(!encodable)
+            continue;
+
+        const qint64 gain = i.value() * (word.toUtf8().size() - 3);
+        if(gain <= 0)
+            continue;
+
+        gains.insert(gain, word);
+        if(gains.count() > size)
+            gains.erase(gains.begin());
+    }
+
+    QStringList result;
+    QMapIterator<qint64, QString> i(gains);
+    i.toBack();
+    while(i.hasPrevious())
+        result << i.previous().value();
+
+    return result;
+}
+
+int VerseCodec::maximumSize()
+{
+    return VERSE_CODEC_LAST_CHAR - VERSE_CODEC_FIRST_CHAR + 1;
+}
+
+VerseCodec VerseCodec::load(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT value FROM General WHERE key=:key");
+    query.bindValue(":key", "Verse/codec");
+    if(!query.exec() || !query.next() || query.record().value(0).toString() != VERSE_CODEC_NAME)
+        return VerseCodec();
+
+    QStringList words;
+    QSqlQuery words_query(db);
+    if(!words_query.exec("SELECT word FROM verse_dict ORDER BY id"))
+    {
+        qDebug() << __PRETTY_FUNCTION__ << words_query.lastError().text();
+        return VerseCodec();
+    }
+
+    while(words_query.next())
+        words << words_query.record().value(0).toString();
+
+    return VerseCodec(words);
+}
+
+bool VerseCodec::save(QSqlDatabase db) const
+{
+    QStringList queries = QStringList()
+            << "DROP TABLE IF EXISTS verse_dict"
+            << "CREATE TABLE verse_dict (id INTEGER PRIMARY KEY NOT NULL, word TEXT NOT NULL)";
+    for(const QString &q: queries)
+    {
+        QSqlQuery query(db);
+        if(!query.exec(q))
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            return false;
+        }
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO verse_dict (id, word) VALUES (:id, :word)");
+    for(int i=0; i<_words.count(); i++)
+    {
+        query.bindValue(":id", i);
+        query.bindValue(":word", _words.at(i));
+        if(!query.exec())
+        {
+            qDebug() << __PRETTY_FUNCTION__ << query.lastError().text();
+            return false;
+        }
+    }
+
+    QSqlQuery general(db);
+    general.prepare("INSERT OR REPLACE INTO General (key,value) VALUES (:key, :value)");
+    general.bindValue(":key", "Verse/codec");
+    general.bindValue(":value", isNull()? QString() : QString(VERSE_CODEC_NAME));
+    if(!general.exec())
+    {
+        qDebug() << __PRETTY_FUNCTION__ << general.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+VerseCodec VerseCodec::codec(const QString &path)
+{
+    QMutexLocker locker(&verse_codec_mutex);
+    if(!verse_codec_cache.contains(path))
+        verse_codec_cache[path] = load(DatabaseConnectionPool::database(path));
+
+    return verse_codec_cache.value(path);
+}
+
+void VerseCodec::invalidate(const QString &path)
+{
+    QMutexLocker locker(&verse_codec_mutex);
+    verse_codec_cache.remove(path);
+}
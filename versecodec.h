@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2017 Aseman Team
+    http://aseman.co
+
+    Meikade is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Meikade is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VERSECODEC_H
+#define VERSECODEC_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSqlDatabase>
+
+/*!
+ * Word dictionary compression for verse texts. Frequent words are replaced
+ * by a single character of the Unicode private use area, the dictionary is
+ * stored in the verse_dict table of the same database. Texts without
+ * private use characters decode to themselves, so plain verses of newly
+ * installed poets can live next to compressed ones.
+ */
+class VerseCodec
+{
+public:
+    VerseCodec(const QStringList &words = QStringList());
+
+    bool isNull() const { return _words.isEmpty(); }
+    QStringList words() const { return _words; }
+
+    QString encode(const QString &text) const;
+    QString decode(const QString &text) const;
+
+    static QStringList train(const QHash<QString, qint64> &frequencies, int size = maximumSize());
+    static int maximumSize();
+
+    static VerseCodec load(QSqlDatabase db);
+    bool save(QSqlDatabase db) const;
+
+    /*! Cached codec of the database file, loaded on first use. */
+    static VerseCodec codec(const QString &path);
+    static void invalidate(const QString &path);
+
+private:
+    QStringList _words;
+    QHash<QString, int> _indexes;
+};
+
+#endif // VERSECODEC_H
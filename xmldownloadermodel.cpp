@@ -20,21 +20,30 @@
 #define XML_DATE_FORMAT "yyyy/MM/dd-HH:mm:ss"
 #define XML_VERSION "1.0"
 #define XML_REVISION_STRUCTURE 1
+#define XML_CACHE_ETAG_KEY "catalog/etag"
+#define XML_CACHE_MODIFIED_KEY "catalog/lastModified"
 
 #include "xmldownloadermodel.h"
 #include "poetscriptinstallerqueue.h"
-#include "asemantools/asemandownloader.h"
+#include "poetscriptinstaller.h"
+#include "downloadscheduler.h"
 #include "asemantools/asemanapplication.h"
 #include "meikade.h"
 #include "meikadedatabase.h"
+#include "meikade_macros.h"
 
 #include <QDebug>
-#include <QDomDocument>
-#include <QDomAttr>
+#include <QDir>
+#include <QFile>
+#include <QXmlStreamReader>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QUrl>
 #include <QPointer>
-#include <QUuid>
+#include <QHash>
 
 class XmlDownloaderModelUnit
 {
@@ -43,6 +52,7 @@ public:
         poetId(0),
         type(-1),
         fileSize(0),
+        fullSize(0),
         thumbSize(0),
         downloaded(false),
         downloading(false),
@@ -66,9 +76,12 @@ public:
     QString compress;
 
     QUrl url;
+    QUrl fullUrl;
     QUrl thumb;
+    QString deltaBase;
 
     qint64 fileSize;
+    qint64 fullSize;
     qint64 thumbSize;
     bool downloaded;
     bool downloading;
@@ -113,8 +126,10 @@ class XmlDownloaderModelPrivate
 {
 public:
     QStringList errors;
-    QPointer<AsemanDownloader> xml_downloader;
-    QHash<QString, AsemanDownloader*> downloaders;
+    QNetworkAccessManager *network;
+    QPointer<QNetworkReply> catalogReply;
+    QByteArray catalogHash;
+    DownloadScheduler *scheduler;
     PoetScriptInstallerQueue *installer;
 
     QString name;
@@ -129,6 +144,14 @@ XmlDownloaderModel::XmlDownloaderModel(QObject *parent) :
     p = new XmlDownloaderModelPrivate;
     p->refreshing = false;
     p->installer = new PoetScriptInstallerQueue(this);
+    p->network = new QNetworkAccessManager(this);
+
+    p->scheduler = new DownloadScheduler(this);
+    p->scheduler->setMaximumParallel(Meikade::settings()->value("downloads/maximumParallel", 3).toInt());
+
+    connect(p->scheduler, &DownloadScheduler::failed, this, &XmlDownloaderModel::fileError);
+    connect(p->scheduler, &DownloadScheduler::finished, this, &XmlDownloaderModel::fileFinished);
+    connect(p->scheduler, &DownloadScheduler::progress, this, &XmlDownloaderModel::fileRecievedBytesChanged);
 
     connect(p->installer, &PoetScriptInstallerQueue::error, this, &XmlDownloaderModel::installerError);
     connect(p->installer, &PoetScriptInstallerQueue::finished, this, &XmlDownloaderModel::installerFinished);
@@ -335,26 +358,65 @@ bool XmlDownloaderModel::refreshing() const
 
 bool XmlDownloaderModel::processing() const
 {
-    return !p->downloaders.isEmpty() || p->installer->isActive();
+    return p->scheduler->isActive() || p->installer->isActive();
+}
+
+void XmlDownloaderModel::setMaximumParallelDownloads(int count)
+{
+    if(p->scheduler->maximumParallel() == count)
+        return;
+
+    p->scheduler->setMaximumParallel(count);
+    Meikade::settings()->setValue("downloads/maximumParallel", p->scheduler->maximumParallel());
+    emit maximumParallelDownloadsChanged();
+}
+
+int XmlDownloaderModel::maximumParallelDownloads() const
+{
+    return p->scheduler->maximumParallel();
 }
 
 void XmlDownloaderModel::refresh()
 {
     if(processing())
         return;
-    if(p->xml_downloader)
+    if(p->catalogReply)
         return;
 
-    changed(QList<XmlDownloaderModelUnit>());
-    loadInstalleds();
+    QFile cache(catalogPath());
+    QByteArray cached;
+    if(cache.open(QFile::ReadOnly))
+    {
+        cached = cache.readAll();
+        cache.close();
+    }
 
-    p->xml_downloader = new AsemanDownloader(this);
-    p->xml_downloader->setPath(XML_DOWNLOAD_LINK);
+    QList<XmlDownloaderModelUnit> result;
+    if(!cached.isEmpty() && readCatalog(cached, result))
+    {
+        p->catalogHash = QCryptographicHash::hash(cached, QCryptographicHash::Md5);
+        changed(result);
+    }
+    else
+    {
+        p->catalogHash.clear();
+        loadInstalleds();
+    }
 
-    connect(p->xml_downloader, &AsemanDownloader::error, this, &XmlDownloaderModel::error);
-    connect(p->xml_downloader, &AsemanDownloader::finished, this, &XmlDownloaderModel::finished);
+    QNetworkRequest request(QUrl(XML_DOWNLOAD_LINK));
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    if(!p->catalogHash.isEmpty())
+    {
+        const QByteArray &etag = Meikade::settings()->value(XML_CACHE_ETAG_KEY).toByteArray();
+        const QByteArray &lastModified = Meikade::settings()->value(XML_CACHE_MODIFIED_KEY).toByteArray();
+        if(!etag.isEmpty())
+            request.setRawHeader("If-None-Match", etag);
+        if(!lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", lastModified);
+    }
 
-    p->xml_downloader->start();
+    p->catalogReply = p->network->get(request);
+    connect(p->catalogReply, &QNetworkReply::finished, this, &XmlDownloaderModel::catalogFinished);
 
     p->refreshing = true;
     emit refreshingChanged();
@@ -379,7 +441,7 @@ void XmlDownloaderModel::loadInstalleds()
         XmlDownloaderModelUnit unit;
         unit.poetId = realPoetId;
         unit.name = db->catName(poetId);
-        unit.guid = QUuid::createUuid().toString();
+        unit.guid = QString("installed:%1").arg(realPoetId);
         unit.installed = true;
         unit.type = (1<<19);
 
@@ -390,153 +452,237 @@ void XmlDownloaderModel::loadInstalleds()
     changed(list);
 }
 
-void XmlDownloaderModel::error(const QStringList &error)
+void XmlDownloaderModel::catalogFinished()
 {
-    p->xml_downloader->deleteLater();
-    p->xml_downloader = 0;
+    QNetworkReply *reply = p->catalogReply;
+    p->catalogReply = 0;
+    if(!reply)
+        return;
 
-    p->refreshing = false;
-    p->errors == error;
+    reply->deleteLater();
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if(reply->error() != QNetworkReply::NoError)
+    {
+        p->errors = QStringList() << reply->errorString();
+        emit errorsChanged();
+    }
+    else
+    if(status != 304)
+    {
+        const QByteArray &data = reply->readAll();
+        const QByteArray &hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+
+        QList<XmlDownloaderModelUnit> result;
+        if(hash != p->catalogHash && readCatalog(data, result))
+        {
+            QFile cache(catalogPath());
+            if(cache.open(QFile::WriteOnly))
+            {
+                cache.write(data);
+                cache.close();
+            }
+
+            p->catalogHash = hash;
+            changed(result);
+        }
+
+        // Validators are only worth keeping when the cache holds the same catalog
+        if(hash == p->catalogHash)
+        {
+            Meikade::settings()->setValue(XML_CACHE_ETAG_KEY, reply->rawHeader("ETag"));
+            Meikade::settings()->setValue(XML_CACHE_MODIFIED_KEY, reply->rawHeader("Last-Modified"));
+        }
+    }
 
-    emit errorsChanged();
+    p->refreshing = false;
     emit refreshingChanged();
 }
 
-void XmlDownloaderModel::finished(const QByteArray &data)
+QString XmlDownloaderModel::catalogPath()
 {
-    changed(QList<XmlDownloaderModelUnit>());
-
-    QList<XmlDownloaderModelUnit> result;
-    QDomDocument dom;
-
-    QString errorStr;
-    int errorLine;
-    int errorColumn;
+    return HOME_PATH + "/catalog.xml";
+}
 
-    if(!dom.setContent(data, true, &errorStr, &errorLine, &errorColumn))
-    {
-        qDebug() << QString("Parse error at line %1, column %2:%3").arg(errorLine).arg(errorColumn).arg(errorStr);
-        return;
-    }
-    if(dom.doctype().name() != "MeikadePoemsXml")
+static void readCatalogRevision(QXmlStreamReader &xml, XmlDownloaderModelUnit &unit, const QDateTime &dbDate,
+                                const QString &installedRevision, bool installed)
+{
+    const QXmlStreamAttributes &attributes = xml.attributes();
+    const int structure = attributes.value("structure").toInt();
+    const QDateTime &date = QDateTime::fromString(attributes.value("date").toString());
+    if(structure > XML_REVISION_STRUCTURE || date < unit.date)
     {
-        qDebug() << "Wrong doc type!";
+        xml.skipCurrentElement();
         return;
     }
 
-    QDomElement root = dom.documentElement();
-    if(root.tagName() != "MeikadePoemsXml")
+    unit.guid = attributes.value("guid").toString();
+    unit.mime = attributes.value("mimeType").toString();
+    unit.compress = attributes.value("compress").toString();
+    unit.version = attributes.value("version").toInt();
+    unit.date = date;
+    unit.structure = structure;
+    unit.installed = installed;
+    unit.updateAvailable = (date.date().year()>2000 && (date>dbDate || dbDate.isNull()) && unit.installed);
+    unit.url.clear();
+    unit.thumb.clear();
+    unit.fileSize = 0;
+    unit.thumbSize = 0;
+    unit.deltaBase.clear();
+
+    QUrl deltaUrl;
+    qint64 deltaSize = 0;
+    while(xml.readNextStartElement())
     {
-        qDebug() << QString("The file is not an TS file.");
-        return;
+        if(xml.name() == "Url")
+        {
+            unit.fileSize = xml.attributes().value("size").toLongLong();
+            unit.url = xml.readElementText();
+        }
+        else
+        if(xml.name() == "Thumb")
+        {
+            unit.thumbSize = xml.attributes().value("size").toLongLong();
+            unit.thumb = xml.readElementText();
+        }
+        else
+        if(xml.name() == "Delta")
+        {
+            const bool match = (unit.updateAvailable && !installedRevision.isEmpty() &&
+                                xml.attributes().value("base") == installedRevision);
+            const qint64 size = xml.attributes().value("size").toLongLong();
+            const QString &url = xml.readElementText();
+            if(match && unit.deltaBase.isEmpty())
+            {
+                unit.deltaBase = installedRevision;
+                deltaUrl = url;
+                deltaSize = size;
+            }
+        }
+        else
+            xml.skipCurrentElement();
     }
-    if(!root.hasAttribute("version") || root.attribute("version") < XML_VERSION)
+
+    unit.fullUrl = unit.url;
+    unit.fullSize = unit.fileSize;
+    if(!unit.deltaBase.isEmpty())
     {
-        qDebug() << QString("The file has old version.");
-        return;
+        unit.url = deltaUrl;
+        unit.fileSize = deltaSize;
     }
+}
 
+static void readCatalogPoet(QXmlStreamReader &xml, QList<XmlDownloaderModelUnit> &result)
+{
     MeikadeDatabase *mdb = Meikade::instance()->database();
+    const QXmlStreamAttributes &attributes = xml.attributes();
+    const int poetId = attributes.value("id").toInt();
+    const QDateTime &dbDate = mdb->poetLastUpdate( mdb->poetCat(poetId) );
+    const QString &installedRevision = mdb->value(PoetScriptInstaller::revisionKey(poetId)).toString();
+    const bool installed = mdb->containsPoet(poetId);
+
+    XmlDownloaderModelUnit unit;
+    unit.name = attributes.value("name").toString();
+    unit.type = attributes.value("type").toInt();
+    unit.poetId = poetId;
+
+    while(xml.readNextStartElement())
+    {
+        if(xml.name() == "Revision")
+            readCatalogRevision(xml, unit, dbDate, installedRevision, installed);
+        else
+            xml.skipCurrentElement();
+    }
 
-    QDomElement nameChild = root.firstChildElement("Name");
-    QDomElement descChild = root.firstChildElement("Description");
-    QDomElement poetsChild = root.firstChildElement("Poets");
+    if(unit.guid.isEmpty())
+        return;
 
-    p->name = nameChild.text();
-    p->description = descChild.text();
+    if(unit.updateAvailable)
+        unit.type = unit.type|(1<<20);
+    if(unit.installed)
+        unit.type = unit.type|(1<<19);
 
-    QDomElement poetChild = poetsChild.firstChildElement("Poet");
-    while(!poetChild.isNull())
-    {
-        const int poetId = poetChild.attribute("id").toInt();
-        const QString &name = poetChild.attribute("name");
-        const int type = poetChild.attribute("type").toInt();
-        const QDateTime &dbDate = Meikade::instance()->database()->poetLastUpdate( Meikade::instance()->database()->poetCat(poetId) );
+    result << unit;
+}
 
-        XmlDownloaderModelUnit unit;
-        unit.name = name;
-        unit.type = type;
-        unit.poetId = poetId;
+/*!
+ * Reads the catalog in a single pass with a stream reader. Every poet keeps
+ * the newest revision with a supported structure, and a delta url is chosen
+ * when one is published for the installed revision.
+ */
+bool XmlDownloaderModel::readCatalog(const QByteArray &data, QList<XmlDownloaderModelUnit> &result)
+{
+    QXmlStreamReader xml(data);
+    QString name;
+    QString description;
+    bool hasDtd = false;
+    bool hasRoot = false;
 
-        QDomElement revision = poetChild.firstChildElement("Revision");
-        while(!revision.isNull())
+    while(!xml.atEnd())
+    {
+        switch(static_cast<int>(xml.readNext()))
         {
-            const int structure = revision.attribute("structure").toInt();
-            const QDateTime &date = QDateTime::fromString(revision.attribute("date"));
-            if(structure > XML_REVISION_STRUCTURE || date < unit.date)
+        case QXmlStreamReader::DTD:
+            if(xml.dtdName() != "MeikadePoemsXml")
             {
-                revision = revision.nextSiblingElement("Poet");
-                continue;
+                qDebug() << "Wrong doc type!";
+                return false;
             }
+            hasDtd = true;
+            break;
 
-            const QString &guid = revision.attribute("guid");
-            const QString &mime = revision.attribute("mimeType");
-            const QString &compress = revision.attribute("compress");
-            const int version = revision.attribute("version").toInt();
-
-            QDomElement urlElement = revision.firstChildElement("Url");
-            QDomElement thumbElement = revision.firstChildElement("Thumb");
-
-            const QString &url = urlElement.text();
-            const QString &thumb = thumbElement.text();
-
-            const qint64 fileSize = urlElement.attribute("size").toLongLong();
-            const qint64 thumbSize = thumbElement.attribute("size").toLongLong();
-
-            unit.guid = guid;
-            unit.mime = mime;
-            unit.compress = compress;
-            unit.url = url;
-            unit.thumb = thumb;
-            unit.fileSize = fileSize;
-            unit.thumbSize = thumbSize;
-            unit.version = version;
-            unit.date = date;
-            unit.structure = structure;
-            unit.installed = mdb->containsPoet(poetId);
-            unit.updateAvailable = (date.date().year()>2000 && (date>dbDate || dbDate.isNull()) && unit.installed);
-            if(unit.updateAvailable)
-                unit.type = unit.type|(1<<20);
-            if(unit.installed)
-                unit.type = unit.type|(1<<19);
-
-            revision = revision.nextSiblingElement("Poet");
+        case QXmlStreamReader::StartElement:
+            if(!hasRoot)
+            {
+                if(!hasDtd || xml.name() != "MeikadePoemsXml")
+                {
+                    qDebug() << QString("The file is not a meikade catalog.");
+                    return false;
+                }
+                if(!xml.attributes().hasAttribute("version") || xml.attributes().value("version").toString() < XML_VERSION)
+                {
+                    qDebug() << QString("The file has old version.");
+                    return false;
+                }
+
+                hasRoot = true;
+            }
+            else
+            if(xml.name() == "Name")
+                name = xml.readElementText();
+            else
+            if(xml.name() == "Description")
+                description = xml.readElementText();
+            else
+            if(xml.name() == "Poet")
+                readCatalogPoet(xml, result);
+            break;
         }
-
-        if(!unit.guid.isEmpty())
-            result << unit;
-
-        poetChild = poetChild.nextSiblingElement("Poet");
     }
 
-    qStableSort(result.begin(), result.end(), sortPersianXmlUnit);
-
-    p->xml_downloader->deleteLater();
-    p->xml_downloader = 0;
+    if(xml.hasError() || !hasRoot)
+    {
+        qDebug() << QString("Parse error at line %1, column %2:%3").arg(xml.lineNumber())
+                    .arg(xml.columnNumber()).arg(xml.errorString());
+        result.clear();
+        return false;
+    }
 
-    changed(result);
+    p->name = name;
+    p->description = description;
 
-    p->refreshing = false;
-    emit refreshingChanged();
+    qStableSort(result.begin(), result.end(), sortPersianXmlUnit);
+    return true;
 }
 
-void XmlDownloaderModel::fileError(const QStringList &error)
+void XmlDownloaderModel::fileError(const QString &guid, const QString &error)
 {
     Q_UNUSED(error)
-    AsemanDownloader *downloader = qobject_cast<AsemanDownloader*>(sender());
-    if(!downloader)
-        return;
-
-    const QString guid = p->downloaders.key(downloader);
-    if(guid.isEmpty())
-        return;
-
-    p->downloaders.remove(guid);
-    downloader->deleteLater();
-
     const int idx = indexOf(guid);
     if(idx == -1)
         return;
+    if(fallbackToFull(idx))
+        return;
 
     XmlDownloaderModelUnit &unit = p->list[idx];
     unit.downloadError = true;
@@ -548,22 +694,8 @@ void XmlDownloaderModel::fileError(const QStringList &error)
                      <<DataRoleDownloadError<<DataRoleDownloadedBytes);
 }
 
-void XmlDownloaderModel::fileFinished(const QByteArray &data)
+void XmlDownloaderModel::fileFinished(const QString &guid, const QString &filePath)
 {
-    Q_UNUSED(data)
-    AsemanDownloader *downloader = qobject_cast<AsemanDownloader*>(sender());
-    if(!downloader)
-        return;
-
-    const QString guid = p->downloaders.key(downloader);
-    if(guid.isEmpty())
-        return;
-
-    const QString filePath = downloader->destination();
-
-    p->downloaders.remove(guid);
-    downloader->deleteLater();
-
     const int idx = indexOf(guid);
     if(idx == -1)
         return;
@@ -575,7 +707,7 @@ void XmlDownloaderModel::fileFinished(const QByteArray &data)
     unit.installing = true;
     unit.installed = false;
 
-    p->installer->append(filePath, unit.guid, unit.poetId, unit.date);
+    p->installer->append(filePath, unit.guid, unit.poetId, unit.date, unit.deltaBase);
 
     QModelIndex index = QAbstractListModel::index(idx);
     emit dataChanged(index, index, QVector<int>()<<DataRoleDownloadingState
@@ -583,22 +715,15 @@ void XmlDownloaderModel::fileFinished(const QByteArray &data)
                      <<DataRoleInstalling<<DataRoleInstalled);
 }
 
-void XmlDownloaderModel::fileRecievedBytesChanged()
+void XmlDownloaderModel::fileRecievedBytesChanged(const QString &guid, qint64 received, qint64 total)
 {
-    AsemanDownloader *downloader = qobject_cast<AsemanDownloader*>(sender());
-    if(!downloader)
-        return;
-
-    const QString guid = p->downloaders.key(downloader);
-    if(guid.isEmpty())
-        return;
-
+    Q_UNUSED(total)
     const int idx = indexOf(guid);
     if(idx == -1)
         return;
 
     XmlDownloaderModelUnit &unit = p->list[idx];
-    unit.downloadedBytes = downloader->recievedBytes();
+    unit.downloadedBytes = received;
 
     QModelIndex index = QAbstractListModel::index(idx);
     emit dataChanged(index, index, QVector<int>()<<DataRoleDownloadedBytes);
@@ -612,6 +737,9 @@ void XmlDownloaderModel::installerError(const QString &file, const QString &guid
     if(idx == -1)
         return;
 
+    if(fallbackToFull(idx))
+        return;
+
     XmlDownloaderModelUnit &unit = p->list[idx];
     unit.downloadError = true;
     unit.downloading = false;
@@ -625,6 +753,32 @@ void XmlDownloaderModel::installerError(const QString &file, const QString &guid
                      <<DataRoleInstalling<<DataRoleInstalled);
 }
 
+/*!
+ * A failed delta (download or patch) is retried once as the full package.
+ * Returns false when the unit was already a full package.
+ */
+bool XmlDownloaderModel::fallbackToFull(int idx)
+{
+    XmlDownloaderModelUnit &unit = p->list[idx];
+    if(unit.deltaBase.isEmpty())
+        return false;
+
+    unit.deltaBase.clear();
+    unit.url = unit.fullUrl;
+    unit.fileSize = unit.fullSize;
+    unit.downloading = false;
+    unit.downloadedBytes = 0;
+    unit.installing = false;
+    unit.installed = true;
+
+    QModelIndex index = QAbstractListModel::index(idx);
+    emit dataChanged(index, index, QVector<int>()<<DataRoleFileDownloadUrl<<DataRoleFileSize
+                     <<DataRoleDownloadedBytes<<DataRoleInstalling<<DataRoleInstalled);
+
+    startDownload(index);
+    return true;
+}
+
 void XmlDownloaderModel::installerFinished(const QString &file, const QString &guid)
 {
     Q_UNUSED(file)
@@ -640,11 +794,15 @@ void XmlDownloaderModel::installerFinished(const QString &file, const QString &g
     unit.installing = false;
     unit.installed = true;
     unit.updateAvailable = false;
+    unit.deltaBase.clear();
+    unit.url = unit.fullUrl;
+    unit.fileSize = unit.fullSize;
 
     QModelIndex index = QAbstractListModel::index(idx);
     emit dataChanged(index, index, QVector<int>()<<DataRoleDownloadingState
                      <<DataRoleDownloadError<<DataRoleDownloadedBytes
-                     <<DataRoleInstalling<<DataRoleInstalled<<DataRoleUpdateAvailable);
+                     <<DataRoleInstalling<<DataRoleInstalled<<DataRoleUpdateAvailable
+                     <<DataRoleFileDownloadUrl<<DataRoleFileSize);
 
     MeikadeDatabase *mdb = Meikade::instance()->database();
     mdb->refresh();
@@ -700,21 +858,15 @@ void XmlDownloaderModel::startDownload(const QModelIndex &index)
     if(unit.downloading || unit.downloaded || unit.removing)
         return;
 
-    if(!p->downloaders.contains(unit.guid))
+    if(!p->scheduler->contains(unit.guid))
     {
-        const QString tmpFile = AsemanApplication::tempPath() + "/" + QUuid::createUuid().toString() + "." + unit.compress;
+        // Named after the package, so a download interrupted by a quit resumes.
+        QString tmpFile = AsemanApplication::tempPath() + "/" + QString(unit.guid).remove('{').remove('}');
+        if(!unit.deltaBase.isEmpty())
+            tmpFile += ".delta";
+        tmpFile += "." + unit.compress;
 
-        AsemanDownloader *downloader = new AsemanDownloader(this);
-        downloader->setPath(unit.url.toString());
-        downloader->setDestination(tmpFile);
-        downloader->setDownloaderId(unit.poetId);
-
-        connect(downloader, SIGNAL(error(QStringList))    , SLOT(fileError(QStringList))    );
-        connect(downloader, SIGNAL(finished(QByteArray))  , SLOT(fileFinished(QByteArray))  );
-        connect(downloader, SIGNAL(recievedBytesChanged()), SLOT(fileRecievedBytesChanged()));
-
-        p->downloaders[unit.guid] = downloader;
-        downloader->start();
+        p->scheduler->enqueue(unit.guid, unit.url, tmpFile);
     }
 
     unit.downloading = true;
@@ -728,11 +880,7 @@ void XmlDownloaderModel::stopDownload(const QModelIndex &index)
     if(!unit.downloading || unit.downloaded || unit.removing)
         return;
 
-    if(p->downloaders.contains(unit.guid))
-    {
-        AsemanDownloader *downloader = p->downloaders.take(unit.guid);
-        downloader->deleteLater();
-    }
+    p->scheduler->cancel(unit.guid);
 
     unit.downloading = false;
     emit dataChanged(index, index, QVector<int>()<<DataRoleDownloadingState);
@@ -751,57 +899,117 @@ void XmlDownloaderModel::startRemoving(const QModelIndex &index)
     emit dataChanged(index, index, QVector<int>()<<DataRoleRemovingState);
 }
 
+static bool updateCatalogUnit(XmlDownloaderModelUnit &unit, const XmlDownloaderModelUnit &from)
+{
+    if(unit.name == from.name && unit.type == from.type && unit.url == from.url &&
+       unit.fileSize == from.fileSize && unit.thumb == from.thumb && unit.installed == from.installed &&
+       unit.updateAvailable == from.updateAvailable && unit.deltaBase == from.deltaBase)
+        return false;
+
+    // Download and install states belong to the running model, not to the catalog
+    unit.name = from.name;
+    unit.type = from.type;
+    unit.url = from.url;
+    unit.fullUrl = from.fullUrl;
+    unit.fileSize = from.fileSize;
+    unit.fullSize = from.fullSize;
+    unit.thumb = from.thumb;
+    unit.thumbSize = from.thumbSize;
+    unit.deltaBase = from.deltaBase;
+    if(!unit.installing && !unit.removing)
+        unit.installed = from.installed;
+    unit.updateAvailable = from.updateAvailable;
+    return true;
+}
+
+/*!
+ * Reconciles the model with the new list, keyed by guid. Rows are removed
+ * and inserted in contiguous ranges, survivors are moved into place and
+ * only the rows whose catalog data differ get a dataChanged.
+ */
 void XmlDownloaderModel::changed(const QList<XmlDownloaderModelUnit> &list)
 {
-    bool count_changed = (list.count()!=p->list.count());
+    const int oldCount = p->list.count();
 
-    for( int i=0 ; i<p->list.count() ; i++ )
+    QHash<QString, int> newIndexes;
+    newIndexes.reserve(list.count());
+    for( int i=0 ; i<list.count() ; i++ )
+        newIndexes[list.at(i).guid] = i;
+
+    for( int i=p->list.count()-1 ; i>=0 ; i-- )
     {
-        const XmlDownloaderModelUnit &file = p->list.at(i);
-        if( list.contains(file) )
+        if( newIndexes.contains(p->list.at(i).guid) )
             continue;
 
-        beginRemoveRows(QModelIndex(), i, i);
-        p->list.removeAt(i);
-        i--;
+        int first = i;
+        while( first > 0 && !newIndexes.contains(p->list.at(first-1).guid) )
+            first--;
+
+        beginRemoveRows(QModelIndex(), first, i);
+        for( int j=i ; j>=first ; j-- )
+            p->list.removeAt(j);
         endRemoveRows();
+
+        i = first;
     }
 
-    QList<XmlDownloaderModelUnit> temp_list = list;
-    for( int i=0 ; i<temp_list.count() ; i++ )
+    QHash<QString, int> current;
+    current.reserve(p->list.count());
+    for( int i=0 ; i<p->list.count() ; i++ )
+        current[p->list.at(i).guid] = i;
+
+    int row = 0;
+    for( const XmlDownloaderModelUnit &file: list )
     {
-        const XmlDownloaderModelUnit &file = temp_list.at(i);
-        if( p->list.contains(file) )
+        if( !current.contains(file.guid) )
             continue;
 
-        temp_list.removeAt(i);
-        i--;
-    }
-    while( p->list != temp_list )
-        for( int i=0 ; i<p->list.count() ; i++ )
+        if( p->list.at(row).guid != file.guid )
         {
-            const XmlDownloaderModelUnit &file = p->list.at(i);
-            int nw = temp_list.indexOf(file);
-            if( i == nw )
-                continue;
+            int from = row+1;
+            while( p->list.at(from).guid != file.guid )
+                from++;
 
-            beginMoveRows( QModelIndex(), i, i, QModelIndex(), nw>i?nw+1:nw );
-            p->list.move( i, nw );
+            beginMoveRows(QModelIndex(), from, from, QModelIndex(), row);
+            p->list.move(from, row);
             endMoveRows();
         }
 
+        row++;
+    }
+
+    int changedFrom = -1;
+    for( int i=0 ; i<=p->list.count() ; i++ )
+    {
+        const bool dirty = (i < p->list.count() && updateCatalogUnit(p->list[i], list.at(newIndexes.value(p->list.at(i).guid))));
+        if( dirty && changedFrom == -1 )
+            changedFrom = i;
+        else
+        if( !dirty && changedFrom != -1 )
+        {
+            emit dataChanged(index(changedFrom), index(i-1));
+            changedFrom = -1;
+        }
+    }
+
     for( int i=0 ; i<list.count() ; i++ )
     {
-        const XmlDownloaderModelUnit &file = list.at(i);
-        if( p->list.contains(file) )
+        if( current.contains(list.at(i).guid) )
             continue;
 
-        beginInsertRows(QModelIndex(), i, i );
-        p->list.insert( i, file );
+        int last = i;
+        while( last+1 < list.count() && !current.contains(list.at(last+1).guid) )
+            last++;
+
+        beginInsertRows(QModelIndex(), i, last);
+        for( int j=i ; j<=last ; j++ )
+            p->list.insert(j, list.at(j));
         endInsertRows();
+
+        i = last;
     }
 
-    if(count_changed)
+    if( oldCount != p->list.count() )
         emit countChanged();
 
     emit listChanged();
@@ -31,6 +31,7 @@ class XmlDownloaderModel : public QAbstractListModel
     Q_PROPERTY(QStringList errors READ errors NOTIFY errorsChanged)
     Q_PROPERTY(bool refreshing READ refreshing NOTIFY refreshingChanged)
     Q_PROPERTY(bool processing READ processing NOTIFY processingChanged)
+    Q_PROPERTY(int maximumParallelDownloads READ maximumParallelDownloads WRITE setMaximumParallelDownloads NOTIFY maximumParallelDownloadsChanged)
 
 public:
     enum DataRoles {
@@ -73,6 +74,9 @@ public:
     bool refreshing() const;
     bool processing() const;
 
+    void setMaximumParallelDownloads(int count);
+    int maximumParallelDownloads() const;
+
 public slots:
     void refresh();
     void loadInstalleds();
@@ -82,14 +86,14 @@ signals:
     void errorsChanged();
     void refreshingChanged();
     void processingChanged();
+    void maximumParallelDownloadsChanged();
     void listChanged();
 
 private slots:
-    void error( const QStringList & error );
-    void finished( const QByteArray & data );
-    void fileError( const QStringList & error );
-    void fileFinished( const QByteArray & data );
-    void fileRecievedBytesChanged();
+    void catalogFinished();
+    void fileError( const QString &guid, const QString &error );
+    void fileFinished( const QString &guid, const QString &filePath );
+    void fileRecievedBytesChanged( const QString &guid, qint64 received, qint64 total );
 
     void installerError(const QString &file, const QString &guid);
     void installerFinished(const QString &file, const QString &guid);
@@ -100,8 +104,11 @@ private:
     void startDownload(const QModelIndex &index);
     void stopDownload(const QModelIndex &index);
     void startRemoving(const QModelIndex &index);
+    bool fallbackToFull(int idx);
 
     void changed(const QList<XmlDownloaderModelUnit> &list);
+    bool readCatalog(const QByteArray &data, QList<XmlDownloaderModelUnit> &result);
+    static QString catalogPath();
 
 private:
     XmlDownloaderModelPrivate *p;
@@ -19,11 +19,13 @@
 #include "xmldownloaderproxymodel.h"
 
 #include <QPointer>
+#include <algorithm>
 
 class XmlDownloaderProxyModelPrivate
 {
 public:
     QPointer<XmlDownloaderModel> model;
+    QList<int> rows;
     int type;
 };
 
@@ -39,21 +41,21 @@ void XmlDownloaderProxyModel::setModel(XmlDownloaderModel *model)
     if(p->model == model)
         return;
 
-    beginResetModel();
     if(p->model)
-    {
-        disconnect(p->model.data(), &XmlDownloaderModel::dataChanged, this, &XmlDownloaderProxyModel::dataChanged_slt);
-        disconnect(p->model.data(), &XmlDownloaderModel::countChanged, this, &XmlDownloaderProxyModel::refresh);
-    }
+        disconnect(p->model.data(), 0, this, 0);
 
     p->model = model;
     if(p->model)
     {
         connect(p->model.data(), &XmlDownloaderModel::dataChanged, this, &XmlDownloaderProxyModel::dataChanged_slt);
-        connect(p->model.data(), &XmlDownloaderModel::countChanged, this, &XmlDownloaderProxyModel::refresh);
+        connect(p->model.data(), &XmlDownloaderModel::rowsInserted, this, &XmlDownloaderProxyModel::rowsInserted_slt);
+        connect(p->model.data(), &XmlDownloaderModel::rowsRemoved, this, &XmlDownloaderProxyModel::rowsRemoved_slt);
+        connect(p->model.data(), &XmlDownloaderModel::rowsMoved, this, &XmlDownloaderProxyModel::rowsMoved_slt);
+        connect(p->model.data(), &XmlDownloaderModel::modelReset, this, &XmlDownloaderProxyModel::refresh);
+        connect(p->model.data(), &XmlDownloaderModel::layoutChanged, this, &XmlDownloaderProxyModel::refresh);
     }
 
-    endResetModel();
+    refresh();
 
     Q_EMIT modelChanged();
 }
@@ -68,9 +70,8 @@ void XmlDownloaderProxyModel::setType(int type)
     if(p->type == type)
         return;
 
-    beginResetModel();
     p->type = type;
-    endResetModel();
+    refresh();
 
     Q_EMIT typeChanged();
 }
@@ -83,19 +84,7 @@ int XmlDownloaderProxyModel::type() const
 int XmlDownloaderProxyModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    if(!p->model)
-        return 0;
-
-    int count = 0;
-    for(int i=0; i<p->model->count(); i++)
-    {
-        QModelIndex idx = p->model->index(i);
-        int type = p->model->data(idx, XmlDownloaderModel::DataRolePoetType).toInt();
-        if(p->type & type)
-            count++;
-    }
-
-    return count;
+    return p->rows.count();
 }
 
 QVariant XmlDownloaderProxyModel::data(const QModelIndex &index, int role) const
@@ -127,58 +116,153 @@ QHash<qint32, QByteArray> XmlDownloaderProxyModel::roleNames() const
 void XmlDownloaderProxyModel::refresh()
 {
     beginResetModel();
+    p->rows = filteredRows();
     endResetModel();
 }
 
-QModelIndex XmlDownloaderProxyModel::mapToModel(const QModelIndex &index) const
+QList<int> XmlDownloaderProxyModel::filteredRows() const
 {
+    QList<int> result;
     if(!p->model)
-        return QModelIndex();
+        return result;
 
-    int count = 0;
     for(int i=0; i<p->model->count(); i++)
-    {
-        QModelIndex idx = p->model->index(i);
-        int type = p->model->data(idx, XmlDownloaderModel::DataRolePoetType).toInt();
-        if(p->type & type)
-        {
-            if(count == index.row())
-                return idx;
-            count++;
-        }
-    }
+        if(accepts(i))
+            result << i;
+
+    return result;
+}
+
+bool XmlDownloaderProxyModel::accepts(int sourceRow) const
+{
+    QModelIndex idx = p->model->index(sourceRow);
+    int type = p->model->data(idx, XmlDownloaderModel::DataRolePoetType).toInt();
+    return (p->type & type);
+}
+
+int XmlDownloaderProxyModel::lowerBound(int sourceRow) const
+{
+    return std::lower_bound(p->rows.constBegin(), p->rows.constEnd(), sourceRow) - p->rows.constBegin();
+}
+
+QModelIndex XmlDownloaderProxyModel::mapToModel(const QModelIndex &index) const
+{
+    if(!p->model || index.row() < 0 || index.row() >= p->rows.count())
+        return QModelIndex();
 
-    return QModelIndex();
+    return p->model->index(p->rows.at(index.row()));
 }
 
 QModelIndex XmlDownloaderProxyModel::mapFromModel(const QModelIndex &index) const
 {
     if(!p->model)
         return QModelIndex();
-    int type = p->model->data(index, XmlDownloaderModel::DataRolePoetType).toInt();
-    if((p->type & type) == 0)
+
+    const int row = lowerBound(index.row());
+    if(row >= p->rows.count() || p->rows.at(row) != index.row())
         return QModelIndex();
 
-    int count = 0;
-    for(int i=0; i<=index.row(); i++)
+    return XmlDownloaderProxyModel::index(row);
+}
+
+void XmlDownloaderProxyModel::dataChanged_slt(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    for(int i=topLeft.row(); i<=bottomRight.row(); i++)
     {
-        QModelIndex idx = p->model->index(i);
-        int type = p->model->data(idx, XmlDownloaderModel::DataRolePoetType).toInt();
-        if(p->type & type)
-            count++;
+        const int row = lowerBound(i);
+        const bool listed = (row < p->rows.count() && p->rows.at(row) == i);
+        const bool accepted = accepts(i);
+
+        if(listed && accepted)
+        {
+            Q_EMIT dataChanged(index(row), index(row), roles);
+        }
+        else
+        if(listed)
+        {
+            beginRemoveRows(QModelIndex(), row, row);
+            p->rows.removeAt(row);
+            endRemoveRows();
+        }
+        else
+        if(accepted)
+        {
+            beginInsertRows(QModelIndex(), row, row);
+            p->rows.insert(row, i);
+            endInsertRows();
+        }
     }
+}
+
+void XmlDownloaderProxyModel::rowsInserted_slt(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent)
+    const int count = last-first+1;
+    const int row = lowerBound(first);
+    for(int i=row; i<p->rows.count(); i++)
+        p->rows[i] += count;
+
+    QList<int> inserted;
+    for(int i=first; i<=last; i++)
+        if(accepts(i))
+            inserted << i;
+    if(inserted.isEmpty())
+        return;
 
-    return p->model->index(count-1);
+    beginInsertRows(QModelIndex(), row, row+inserted.count()-1);
+    for(int i=0; i<inserted.count(); i++)
+        p->rows.insert(row+i, inserted.at(i));
+    endInsertRows();
 }
 
-void XmlDownloaderProxyModel::dataChanged_slt(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+void XmlDownloaderProxyModel::rowsRemoved_slt(const QModelIndex &parent, int first, int last)
 {
-    QModelIndex tlIdx = mapFromModel(topLeft);
-    QModelIndex brIdx = mapFromModel(bottomRight);
-    if(!tlIdx.isValid() || !brIdx.isValid())
+    Q_UNUSED(parent)
+    const int count = last-first+1;
+    const int from = lowerBound(first);
+    const int to = lowerBound(last+1);
+    if(from < to)
+    {
+        beginRemoveRows(QModelIndex(), from, to-1);
+        p->rows.erase(p->rows.begin()+from, p->rows.begin()+to);
+        endRemoveRows();
+    }
+
+    for(int i=from; i<p->rows.count(); i++)
+        p->rows[i] -= count;
+}
+
+void XmlDownloaderProxyModel::rowsMoved_slt(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row)
+{
+    Q_UNUSED(parent)
+    Q_UNUSED(destination)
+    if(start != end)
+    {
+        refresh();
+        return;
+    }
+
+    const int oldRow = lowerBound(start);
+    const bool listed = (oldRow < p->rows.count() && p->rows.at(oldRow) == start);
+    const QList<int> &rows = filteredRows();
+    if(!listed)
+    {
+        // Only the source rows around the hidden one have shifted
+        p->rows = rows;
+        return;
+    }
+
+    const int target = (row > start? row-1 : row);
+    const int newRow = std::lower_bound(rows.constBegin(), rows.constEnd(), target) - rows.constBegin();
+    if(newRow == oldRow)
+    {
+        p->rows = rows;
         return;
+    }
 
-    Q_EMIT dataChanged(tlIdx, brIdx, roles);
+    beginMoveRows(QModelIndex(), oldRow, oldRow, QModelIndex(), newRow>oldRow? newRow+1 : newRow);
+    p->rows = rows;
+    endMoveRows();
 }
 
 XmlDownloaderProxyModel::~XmlDownloaderProxyModel()
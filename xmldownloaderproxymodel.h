@@ -56,8 +56,15 @@ protected:
     QModelIndex mapToModel(const QModelIndex &index) const;
     QModelIndex mapFromModel(const QModelIndex &index) const;
 
+    QList<int> filteredRows() const;
+    bool accepts(int sourceRow) const;
+    int lowerBound(int sourceRow) const;
+
 private slots:
     void dataChanged_slt(const QModelIndex & topLeft, const QModelIndex & bottomRight, const QVector<int> & roles = QVector<int> ());
+    void rowsInserted_slt(const QModelIndex &parent, int first, int last);
+    void rowsRemoved_slt(const QModelIndex &parent, int first, int last);
+    void rowsMoved_slt(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row);
 
 private:
     XmlDownloaderProxyModelPrivate *p;